@@ -0,0 +1,453 @@
+/**************************************************************
+
+   bench.cpp - Modeline engine benchmarks
+
+   ---------------------------------------------------------
+
+   Switchres   Modeline generation engine for emulation
+
+   License     GPL-2.0+
+   Copyright   2010-2021 Chris Kennedy, Antonio Giner,
+                         Alexandre Wodarczyk, Gil Delescluse
+
+ **************************************************************/
+
+// Runs headless on the base display manager ("ram" screen), no video backend
+// is initialized. Usage: bench [--json] [--time <ms>] [--ini <file.ini>]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <functional>
+#include "switchres.h"
+#include "tests/test_common.h"
+
+using namespace std;
+
+//============================================================
+//  Allocation counting
+//============================================================
+
+static atomic<long> alloc_count(0);
+
+void *operator new(size_t size)
+{
+	alloc_count++;
+	void *p = malloc(size? size : 1);
+	if (!p) throw bad_alloc();
+	return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+//============================================================
+//  Test data
+//============================================================
+
+static const char *modeline_presets[] = { "generic_15", "arcade_15", "arcade_15ex", "arcade_25", "arcade_31", "arcade_15_25", "arcade_15_25_31",
+	"m2929", "d9800", "k7000", "h9110", "pc_31_120", "pc_70_120", "vesa_480", "vesa_1024", "pal", "ntsc" };
+
+static const char *get_mode_presets[] = { "generic_15", "arcade_15", "arcade_15_25_31", "d9800", "pc_31_120" };
+
+static const mode_request arcade_modes[] = {
+	{ 256, 224, 60.0, false }, { 320, 240, 59.94, false }, { 384, 224, 59.637405, false }, { 288, 224, 60.606061, false },
+	{ 320, 224, 59.185606, false }, { 256, 240, 57.5, false }, { 336, 240, 59.637405, false }, { 224, 288, 60.606061, false },
+	{ 304, 256, 55.017606, false }, { 256, 256, 60.0, false }, { 384, 256, 55.017606, false }, { 496, 384, 57.524160, false },
+	{ 512, 384, 60.0, false }, { 400, 254, 55.9, false }, { 320, 256, 50.0, false }, { 512, 224, 60.0, false },
+	{ 240, 320, 59.0, false }, { 640, 480, 60.0, true }, { 512, 448, 59.94, true }, { 160, 144, 59.7275, false },
+	{ 640, 480, 59.94, false }, { 256, 192, 50.0, false }, { 368, 240, 60.0, false }, { 448, 224, 59.1, false },
+};
+
+static const char *test_modeline = "6.514560 320 333 364 416 240 241 244 261 -hsync -vsync";
+
+//============================================================
+//  Benchmark runner
+//============================================================
+
+typedef struct bench_result
+{
+	string name;
+	long ops;
+	double ns_per_op;
+	double candidates_per_s;
+	double allocs_per_op;
+	double quality; // share of results matching the full search, negative if not measured
+} bench_result;
+
+static vector<bench_result> results;
+static double min_time_ms = 200;
+
+static void run_bench(const char *name, long candidates_per_op, function<void()> op)
+{
+	// Warm up, then grow the batch until it runs long enough to time
+	op();
+
+	long batch = 1;
+	for (;;)
+	{
+		long allocs = alloc_count;
+		auto start = chrono::steady_clock::now();
+
+		for (long i = 0; i < batch; i++)
+			op();
+
+		double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+		long allocs_done = alloc_count - allocs;
+
+		if (ns >= min_time_ms * 1000000 || batch >= (1L << 30))
+		{
+			double ns_per_op = ns / batch;
+			results.push_back({ name, batch, ns_per_op, candidates_per_op? candidates_per_op * 1e9 / ns_per_op : 0, double(allocs_done) / batch, -1 });
+			return;
+		}
+
+		batch *= 2;
+	}
+}
+
+//============================================================
+//  Display setup
+//============================================================
+
+static display_manager *make_display(switchres_manager &switchres, const char *preset)
+{
+	// Base display manager: "ram" screen, new modes can be added, no backend
+	display_manager *display = make_display(switchres, preset, nullptr);
+
+	// A typical desktop mode list
+	const int desktop[][4] = { { 640, 480, 60, MODE_DESKTOP }, { 800, 600, 60, MODE_OK }, { 1024, 768, 60, MODE_OK },
+		{ 720, 576, 50, MODE_OK }, { 720, 480, 60, MODE_OK } };
+
+	add_modes(display, desktop);
+	return display;
+}
+
+static int num_ranges(display_manager *display)
+{
+	int n = 0;
+	for (int i = 0; i < MAX_RANGES; i++)
+		if (display->range[i].hfreq_min) n++;
+	return n;
+}
+
+//============================================================
+//  Benchmarks
+//============================================================
+
+static void bench_modeline_create(int timing_engine, double refresh_ppm = 0)
+{
+	for (auto preset : modeline_presets)
+	{
+		monitor_range range[MAX_RANGES];
+		memset(range, 0, sizeof(range));
+		monitor_set_preset((char *)preset, range);
+
+		generator_settings gs = {};
+		gs.interlace = 1;
+		gs.doublescan = 1;
+		gs.monitor_aspect = STANDARD_CRT_ASPECT;
+		gs.refresh_tolerance = 2.0;
+		gs.super_width = 2560;
+		gs.h_size = 1.0;
+		gs.pixel_precision = 1;
+		gs.timing_engine = timing_engine;
+
+		// Exact refresh search against a kHz clock, as most backends have
+		gs.refresh_ppm = refresh_ppm;
+		if (refresh_ppm > 0)
+			gs.constraints.pclock_quantum = 1000;
+
+		size_t n = 0;
+		char name[64];
+		snprintf(name, sizeof(name), "modeline_create%s%s/%s", timing_engine == TIMING_ENGINE_FIXED? "_fixed" : "", refresh_ppm > 0? "_exact" : "", preset);
+
+		run_bench(name, 1, [&]()
+		{
+			const mode_request &request = arcade_modes[n++ % (sizeof(arcade_modes) / sizeof(arcade_modes[0]))];
+			modeline s_mode = {}, t_mode = {};
+			s_mode.hactive = normalize(request.width, 8);
+			s_mode.vactive = request.height;
+			s_mode.vfreq = request.refresh;
+			s_mode.interlace = request.interlace;
+			t_mode = s_mode;
+			t_mode.type = XYV_EDITABLE | SCAN_EDITABLE;
+			modeline_create(&s_mode, &t_mode, &range[0], &gs);
+		});
+	}
+}
+
+static void bench_get_mode(switchres_manager &switchres)
+{
+	const size_t num_modes = sizeof(arcade_modes) / sizeof(arcade_modes[0]);
+
+	for (auto preset : get_mode_presets)
+	{
+		display_manager *display = make_display(switchres, preset);
+		size_t table_size = display->video_modes.size();
+		long candidates = (table_size + 1) * num_ranges(display);
+		size_t n = 0;
+		char name[64];
+
+		// Full search each time, the mode list is put back as it was
+		snprintf(name, sizeof(name), "get_mode/%s", preset);
+		run_bench(name, candidates, [&]()
+		{
+			const mode_request &r = arcade_modes[n++ % num_modes];
+			display->clear_mode_cache();
+			display->get_mode(r.width, r.height, r.refresh, r.interlace);
+			display->video_modes.resize(table_size);
+		});
+
+		// Same requests answered from the result cache
+		snprintf(name, sizeof(name), "get_mode_cached/%s", preset);
+		run_bench(name, 0, [&]()
+		{
+			const mode_request &r = arcade_modes[n++ % num_modes];
+			display->get_mode(r.width, r.height, r.refresh, r.interlace);
+			display->video_modes.resize(table_size);
+		});
+
+		// Refresh only changes, solved again on the previous winner
+		const float refresh_toggle[] = { 60.0, 59.94, 50.0, 59.94 };
+		snprintf(name, sizeof(name), "get_mode_refresh/%s", preset);
+		run_bench(name, 0, [&]()
+		{
+			display->clear_mode_cache();
+			display->get_mode(320, 240, refresh_toggle[n++ % 4], false);
+		});
+		display->video_modes.resize(table_size);
+
+		// Time budgeted searches, current mode first. Quality is the share of
+		// results with the same timings as the full search
+		vector<modeline> full(num_modes);
+		for (size_t i = 0; i < num_modes; i++)
+		{
+			display->clear_mode_cache();
+			modeline *mode = display->get_mode(arcade_modes[i].width, arcade_modes[i].height, arcade_modes[i].refresh, arcade_modes[i].interlace);
+			full[i] = mode? *mode : modeline {};
+			display->video_modes.resize(table_size);
+		}
+
+		display->set_current_mode(&display->video_modes[0]);
+		for (int budget_us : { 1, 2, 5 })
+		{
+			long done = 0, same = 0;
+			snprintf(name, sizeof(name), "get_mode_deadline_%dus/%s", budget_us, preset);
+			run_bench(name, 0, [&]()
+			{
+				size_t i = n++ % num_modes;
+				const mode_request &r = arcade_modes[i];
+				display->clear_mode_cache();
+				modeline *mode = display->get_mode(r.width, r.height, r.refresh, r.interlace, chrono::steady_clock::now() + chrono::microseconds(budget_us));
+				if (mode? mode->pclock == full[i].pclock && mode->htotal == full[i].htotal && mode->vtotal == full[i].vtotal : full[i].pclock == 0)
+					same++;
+				done++;
+				display->video_modes.resize(table_size);
+			});
+			results.back().quality = double(same) / done;
+		}
+		display->set_current_mode(nullptr);
+
+		// The whole list at once, on all cores
+		vector<mode_request> requests(arcade_modes, arcade_modes + num_modes);
+		vector<modeline> modes;
+		snprintf(name, sizeof(name), "get_modes_batch/%s", preset);
+		run_bench(name, candidates * num_modes, [&]() { display->get_modes(requests, modes); });
+
+		delete display;
+	}
+}
+
+static void bench_get_mode_large(switchres_manager &switchres)
+{
+	// A driver mode list as big as LCD/VRR screens report, the search is split
+	// across the work pool
+	const size_t num_modes = sizeof(arcade_modes) / sizeof(arcade_modes[0]);
+	const int widths[] = { 640, 720, 800, 1024, 1152, 1280, 1366, 1440, 1600, 1680, 1920, 2560 };
+	const int heights[] = { 480, 576, 600, 720, 768, 800, 864, 900, 960, 1024, 1050, 1080, 1200, 1440 };
+	const int rates[] = { 50, 60 };
+
+	for (auto preset : get_mode_presets)
+	{
+		display_manager *display = make_display(switchres, preset);
+		for (int w : widths) for (int h : heights) for (int r : rates)
+		{
+			modeline mode = {};
+			mode.width = mode.hactive = w;
+			mode.height = mode.vactive = h;
+			mode.refresh = r;
+			mode.vfreq = r;
+			modeline_vesa_gtf(&mode);
+			display->video_modes.push_back(mode);
+		}
+
+		size_t table_size = display->video_modes.size();
+		long candidates = (table_size + 1) * num_ranges(display);
+		size_t n = 0;
+		char name[64];
+
+		snprintf(name, sizeof(name), "get_mode_large/%s", preset);
+		run_bench(name, candidates, [&]()
+		{
+			const mode_request &r = arcade_modes[n++ % num_modes];
+			display->clear_mode_cache();
+			display->get_mode(r.width, r.height, r.refresh, r.interlace);
+			display->video_modes.resize(table_size);
+		});
+
+		// Same list with a -resolution rule that locks most of it
+		modeline user_mode = {};
+		user_mode.height = 480;
+		display->set_user_mode(&user_mode);
+
+		long unlocked = 0;
+		for (auto &mode : display->video_modes)
+			if (!(mode.type & MODE_DISABLED))
+				unlocked++;
+
+		snprintf(name, sizeof(name), "get_mode_locked/%s", preset);
+		run_bench(name, (unlocked + 1) * num_ranges(display), [&]()
+		{
+			const mode_request &r = arcade_modes[n++ % num_modes];
+			display->clear_mode_cache();
+			display->get_mode(r.width, r.height, r.refresh, r.interlace);
+			display->video_modes.resize(table_size);
+		});
+
+		delete display;
+	}
+}
+
+static void bench_monitor_set_preset()
+{
+	size_t n = 0;
+	run_bench("monitor_set_preset", 0, [&]()
+	{
+		monitor_range range[MAX_RANGES];
+		memset(range, 0, sizeof(range));
+		monitor_set_preset((char *)modeline_presets[n++ % (sizeof(modeline_presets) / sizeof(modeline_presets[0]))], range);
+	});
+}
+
+static void bench_parse_config(const char *ini_file)
+{
+	switchres_manager switchres;
+	switchres.set_log_level(0);
+
+	if (!switchres.parse_config(ini_file))
+	{
+		fprintf(stderr, "bench: %s not found, skipping parse_config\n", ini_file);
+		return;
+	}
+
+	run_bench("parse_config", 0, [&]() { switchres.parse_config(ini_file); });
+}
+
+static void bench_modeline_text()
+{
+	char buffer[256];
+	modeline mode = {};
+
+	run_bench("modeline_parse", 0, [&]() { modeline_parse(test_modeline, &mode); });
+	run_bench("modeline_print", 0, [&]() { modeline_print(&mode, buffer, MS_FULL); });
+}
+
+static void bench_edid()
+{
+	monitor_range range[MAX_RANGES];
+	memset(range, 0, sizeof(range));
+	monitor_set_preset((char *)"generic_15", range);
+
+	modeline mode = {};
+	modeline_parse(test_modeline, &mode);
+	mode.range = 0;
+
+	char name[] = "generic_15";
+	edid_block edid = {};
+	run_bench("edid_from_modeline", 0, [&]() { edid_from_modeline(&mode, &range[0], name, &edid); });
+}
+
+//============================================================
+//  Output
+//============================================================
+
+static void print_text()
+{
+	printf("%-36s %12s %14s %16s %12s %9s\n", "benchmark", "ops", "ns/op", "candidates/s", "allocs/op", "quality");
+	for (auto &r : results)
+	{
+		printf("%-36s %12ld %14.1f %16.0f %12.2f", r.name.c_str(), r.ops, r.ns_per_op, r.candidates_per_s, r.allocs_per_op);
+		if (r.quality >= 0)
+			printf(" %8.1f%%", r.quality * 100);
+		printf("\n");
+	}
+}
+
+static void print_json()
+{
+	printf("{\n  \"version\": \"%s\",\n  \"benchmarks\": [\n", SWITCHRES_VERSION);
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		auto &r = results[i];
+		printf("    { \"name\": \"%s\", \"ops\": %ld, \"ns_per_op\": %.3f, \"candidates_per_s\": %.0f, \"allocs_per_op\": %.3f",
+			r.name.c_str(), r.ops, r.ns_per_op, r.candidates_per_s, r.allocs_per_op);
+		if (r.quality >= 0)
+			printf(", \"quality\": %.4f", r.quality);
+		printf(" }%s\n", i + 1 < results.size()? "," : "");
+	}
+	printf("  ]\n}\n");
+}
+
+//============================================================
+//  main
+//============================================================
+
+int main(int argc, char **argv)
+{
+	bool json = false;
+	const char *ini_file = "switchres.ini";
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-j") || !strcmp(argv[i], "--json"))
+			json = true;
+		else if ((!strcmp(argv[i], "-t") || !strcmp(argv[i], "--time")) && i + 1 < argc)
+			min_time_ms = atof(argv[++i]);
+		else if ((!strcmp(argv[i], "-i") || !strcmp(argv[i], "--ini")) && i + 1 < argc)
+			ini_file = argv[++i];
+		else
+		{
+			printf("Usage: bench [options]\nOptions:\n"
+				"  -j, --json                        Output results as JSON\n"
+				"  -t, --time <ms>                   Minimum time per benchmark (default 200)\n"
+				"  -i, --ini <file.ini>              Ini file for the parse_config benchmark (default switchres.ini)\n");
+			return 0;
+		}
+	}
+
+	switchres_manager switchres;
+	switchres.set_log_level(0);
+
+	bench_modeline_create(TIMING_ENGINE_DOUBLE);
+	bench_modeline_create(TIMING_ENGINE_FIXED);
+	bench_modeline_create(TIMING_ENGINE_DOUBLE, 1.0);
+	bench_get_mode(switchres);
+	bench_get_mode_large(switchres);
+	bench_monitor_set_preset();
+	bench_parse_config(ini_file);
+	bench_modeline_text();
+	bench_edid();
+
+	if (json)
+		print_json();
+	else
+		print_text();
+
+	return 0;
+}
@@ -68,6 +68,7 @@ public:
 	virtual const char *api_name() { return "empty"; }
 	virtual bool init();
 	virtual int caps() { return 0; }
+	virtual timing_constraints constraints() { return {}; }
 
 	virtual bool add_mode(modeline *mode);
 	virtual bool delete_mode(modeline *mode);
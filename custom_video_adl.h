@@ -148,6 +148,8 @@ class adl_timing : public custom_video
 		bool init();
 		void close();
 		int caps() { return allow_hardware_refresh()? CUSTOM_VIDEO_CAPS_UPDATE | CUSTOM_VIDEO_CAPS_ADD | CUSTOM_VIDEO_CAPS_DESKTOP_EDITABLE : is_patched? CUSTOM_VIDEO_CAPS_UPDATE : 0; }
+		// 16-bit clock in 10 kHz units, signed 16-bit timings
+		timing_constraints constraints() { return { 10000, 0, 655350000, 0, 32767, 32767 }; }
 
 		bool add_mode(modeline *mode);
 		bool delete_mode(modeline *mode);
@@ -28,6 +28,8 @@ class ati_timing : public custom_video
 		const char *api_name() { return "ATI Legacy"; }
 		bool init();
 		int caps() { return CUSTOM_VIDEO_CAPS_UPDATE | CUSTOM_VIDEO_CAPS_SCAN_EDITABLE; }
+		// Clock in 10 kHz units
+		timing_constraints constraints() { return { 10000, 0, 0, 0, 0, 0 }; }
 
 		bool update_mode(modeline *mode);
 
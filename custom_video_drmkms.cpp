@@ -174,6 +174,32 @@ void modeline_to_drm_modeline(int id, modeline *mode, drmModeModeInfo *drmmode)
 	drmmode->vrefresh    = mode->refresh;  // Used only for human readable output
 }
 
+//============================================================
+//  Hash the timings of a DRM modeline
+//============================================================
+
+uint64_t drm_modeline_hash(const drmModeModeInfo *drmmode)
+{
+	// Same hash as the SR modeline they come from, as far as DRM keeps it
+	modeline mode = {};
+
+	mode.pclock     = drmmode->clock * 1000;
+	mode.hactive    = drmmode->hdisplay;
+	mode.hbegin     = drmmode->hsync_start;
+	mode.hend       = drmmode->hsync_end;
+	mode.htotal     = drmmode->htotal;
+	mode.vactive    = drmmode->vdisplay;
+	mode.vbegin     = drmmode->vsync_start;
+	mode.vend       = drmmode->vsync_end;
+	mode.vtotal     = drmmode->vtotal;
+	mode.interlace  = (drmmode->flags & DRM_MODE_FLAG_INTERLACE) ? 1 : 0;
+	mode.doublescan = (drmmode->flags & DRM_MODE_FLAG_DBLSCAN) ? 1 : 0;
+	mode.hsync      = (drmmode->flags & DRM_MODE_FLAG_PHSYNC) ? 1 : 0;
+	mode.vsync      = (drmmode->flags & DRM_MODE_FLAG_PVSYNC) ? 1 : 0;
+
+	return modeline_timing_hash(&mode);
+}
+
 //============================================================
 //  drmkms_timing::test_kernel_user_modes
 //============================================================
@@ -825,18 +851,24 @@ bool drmkms_timing::update_mode(modeline *mode)
 		return true;
 	}
 
-	// libdrn hook case, we can update timings directly in the connector's data
+	// libdrn hook case, we can update timings directly in the connector's data.
+	// Listed modes are found by position, the ones we attached by their hash
 	drmModeConnector *conn = drmModeGetConnectorCurrent(m_drm_fd, m_desktop_output);
 	if (conn)
 	{
+		bool attached = m_kms_modes.count(mode->platform_data);
 		for (int i = 0; i < conn->count_modes; i++)
 		{
 			drmModeModeInfo *drmmode = &conn->modes[i];
-			if ((int)mode->platform_data == i)
+			if (attached? drm_modeline_hash(drmmode) == mode->platform_data : (int)mode->platform_data == i)
 			{
 				int m_type = drmmode->type;
+				m_kms_modes.erase(drm_modeline_hash(drmmode));
 				modeline_to_drm_modeline(m_id, mode, drmmode);
 				drmmode->type = m_type;
+				m_kms_modes[drm_modeline_hash(drmmode)] = *drmmode;
+				if (attached)
+					mode->platform_data = drm_modeline_hash(drmmode);
 				return true;
 			}
 		}
@@ -903,6 +935,10 @@ bool drmkms_timing::add_mode(modeline *mode)
 		log_verbose("DRM/KMS: <%d> (%s) Mode added\n", m_id, __FUNCTION__);
 		if (fd != m_hook_fd)
 			drmDropMaster(fd);
+
+		// The mode keeps the hash it's in the connector under, its timings may change
+		m_kms_modes[drm_modeline_hash(&drmmode)] = drmmode;
+		mode->platform_data = drm_modeline_hash(&drmmode);
 	}
 
 	return true;
@@ -1078,8 +1114,15 @@ bool drmkms_timing::delete_mode(modeline *mode)
 
 	if (m_kernel_user_modes)
 	{
-		int i = 0, ret = 0, fd = -1;
-		drmModeConnector *conn;
+		int ret = 0, fd = -1;
+
+		// The connector's mode as we attached it, mode may hold new timings already
+		auto it = m_kms_modes.find(attached_hash(mode));
+		if (it == m_kms_modes.end())
+		{
+			log_verbose("DRM/KMS: <%d> (%s) Couldn't find the mode in the connector: %dx%d\n", m_id, __FUNCTION__, mode->hactive, mode->vactive);
+			return false;
+		}
 
 		// If SR was initilized before SDL2 for instance, SR lost the DRM
 		fd = get_master_fd();
@@ -1089,26 +1132,16 @@ bool drmkms_timing::delete_mode(modeline *mode)
 			return false;
 		}
 
-		drmModeModeInfo srmode;
-		conn = drmModeGetConnectorCurrent(fd, m_desktop_output);
-		modeline_to_drm_modeline(m_id, mode, &srmode);
-		for (i = 0; i < conn->count_modes; i++)
+		ret = drmModeDetachMode(fd, m_desktop_output, &it->second);
+		if (fd != m_hook_fd)
+			drmDropMaster(m_drm_fd);
+		if (ret != 0)
 		{
-			drmModeModeInfo *drmmode = &conn->modes[i];
-			ret = strcmp(drmmode->name, srmode.name);
-			if (ret != 0)
-				continue;
-			ret = drmModeDetachMode(fd, m_desktop_output, drmmode);
-			if (fd != m_hook_fd)
-				drmDropMaster(m_drm_fd);
-			drmModeFreeConnector(conn);
-			if (ret != 0)
-			{
-				log_verbose("DRM/KMS: <%d> (%s) Failed removing kernel user mode: %s (ret=%d)\n", m_id, __FUNCTION__, drmmode->name, ret);
-				return false;
-			}
-			return true;
+			log_verbose("DRM/KMS: <%d> (%s) Failed removing kernel user mode: %s (ret=%d)\n", m_id, __FUNCTION__, it->second.name, ret);
+			return false;
 		}
+		m_kms_modes.erase(it);
+		mode->platform_data = 0;
 	}
 
 	return true;
@@ -1127,6 +1160,10 @@ bool drmkms_timing::get_timing(modeline *mode)
 		return false;
 	}
 
+	// A new listing, map the connector's modes again
+	if (m_video_modes_position == 0)
+		m_kms_modes.clear();
+
 	// INFO: not used vrefresh, hskew, vscan
 	drmModeRes *p_res = drmModeGetResources(m_drm_fd);
 
@@ -1143,6 +1180,7 @@ bool drmkms_timing::get_timing(modeline *mode)
 
 				// Use mode position as index
 				mode->platform_data = m_video_modes_position - 1;
+				m_kms_modes[drm_modeline_hash(pdmode)] = *pdmode;
 
 				mode->pclock        = pdmode->clock * 1000;
 				mode->hactive       = pdmode->hdisplay;
@@ -1251,26 +1289,32 @@ void drmkms_timing::list_drm_modes()
 
 bool drmkms_timing::kms_has_mode(modeline* mode)
 {
-	int i = 0;
-	drmModeConnector *conn;
 	drmModeModeInfo drmmode;
 
-	// To avoid matching issues, we just compare the relevant timing fields
-	int size_to_compare = sizeof(drmModeModeInfo) - sizeof(drmModeModeInfo::type) - sizeof(drmModeModeInfo::name);
-
+	// Only the timings as DRM keeps them decide, not the mode name
 	modeline_to_drm_modeline(m_id,  mode, &drmmode);
 
-	conn = drmModeGetConnectorCurrent(m_drm_fd, m_desktop_output);
-	for (i = 0; i < conn->count_modes; i++)
+	if (m_kms_modes.count(drm_modeline_hash(&drmmode)))
 	{
-		if (memcmp(&drmmode, &conn->modes[i], size_to_compare) == 0)
-		{
-			log_verbose("DRM/KMS: <%d> (%s) Found the mode in the connector\n", m_id, __FUNCTION__);
-			drmModeFreeConnector(conn);
-			return true;
-		}
+		log_verbose("DRM/KMS: <%d> (%s) Found the mode in the connector\n", m_id, __FUNCTION__);
+		return true;
 	}
 	log_verbose("DRM/KMS: <%d> (%s) Couldn't find the mode in the connector\n", m_id, __FUNCTION__);
-	drmModeFreeConnector(conn);
 	return false;
 }
+
+//============================================================
+//  drmkms_timing::attached_hash
+//============================================================
+
+uint64_t drmkms_timing::attached_hash(modeline *mode)
+{
+	// Modes we attached carry their hash. Listed modes can't have their
+	// timings changed without the hook, theirs still hold
+	if (m_kms_modes.count(mode->platform_data))
+		return mode->platform_data;
+
+	drmModeModeInfo drmmode;
+	modeline_to_drm_modeline(m_id, mode, &drmmode);
+	return drm_modeline_hash(&drmmode);
+}
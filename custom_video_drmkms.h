@@ -15,6 +15,8 @@
 #ifndef __CUSTOM_VIDEO_DRMKMS_
 #define __CUSTOM_VIDEO_DRMKMS_
 
+#include <unordered_map>
+
 // DRM headers
 #include <xf86drm.h>
 #include <xf86drmMode.h>
@@ -27,6 +29,8 @@ class drmkms_timing : public custom_video
 		~drmkms_timing();
 		const char *api_name() { return "DRMKMS"; }
 		int caps() { return m_caps; }
+		// kHz clock, 16-bit timings
+		timing_constraints constraints() { return { 1000, 0, 0, 0, 65535, 65535 }; }
 		bool init();
 
 		bool add_mode(modeline *mode);
@@ -56,6 +60,9 @@ class drmkms_timing : public custom_video
 		unsigned int m_desktop_output = 0;
 		int m_video_modes_position = 0;
 
+		// The connector's modes by timing hash
+		std::unordered_map<uint64_t, drmModeModeInfo> m_kms_modes;
+
 		void *mp_drm_handle = NULL;
 		unsigned int m_dumb_handle = 0;
 		unsigned int m_framebuffer_id = 0;
@@ -89,6 +96,7 @@ class drmkms_timing : public custom_video
 
 		bool test_kernel_user_modes();
 		bool kms_has_mode(modeline*);
+		uint64_t attached_hash(modeline *mode);
 		void list_drm_modes();
 		int get_master_fd();
 
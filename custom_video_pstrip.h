@@ -51,6 +51,8 @@ class pstrip_timing : public custom_video
 		const char *api_name() { return "PowerStrip"; }
 		bool init();
 		int caps() { return CUSTOM_VIDEO_CAPS_UPDATE | CUSTOM_VIDEO_CAPS_SCAN_EDITABLE | CUSTOM_VIDEO_CAPS_DESKTOP_EDITABLE; }
+		// Clock in kHz
+		timing_constraints constraints() { return { 1000, 0, 0, 0, 0, 0 }; }
 
 		bool update_mode(modeline *mode);
 
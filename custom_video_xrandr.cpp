@@ -599,26 +599,19 @@ bool xrandr_timing::add_mode(modeline *mode)
 		return false;
 	}
 
-	// Check if mode is available from the plaftform_data mode id
-	XRRModeInfo *pxmode = find_mode(mode);
-	if (pxmode != NULL)
+	// Check if the output already has these timings. A mode we didn't create is
+	// used as is but stays the server's, delete_mode leaves it alone
+	RRMode id = find_mode(mode);
+	if (id != 0)
 	{
-		log_error("XRANDR: <%d> (add_mode) [WARNING] mode already exist\n", m_id);
+		log_error("XRANDR: <%d> (add_mode) [WARNING] mode already exist%s\n", m_id, m_created_ids.count(id)? "" : " as a system mode");
+		mode->platform_data = id;
 		return true;
 	}
 
-	// Create specific mode name
+	// Create specific mode name, the timing hash keeps it unique as the server requires
 	char name[48];
-	sprintf(name, "SR-%d_%dx%d@%.02f%s", m_id, mode->hactive, mode->vactive, mode->vfreq, mode->interlace ? "i" : "");
-
-	// Check if mode is available from the SR name (should not be the case, otherwise it means that we recevied twice the same mode request)
-	pxmode = find_mode_by_name(name);
-	if (pxmode != NULL)
-	{
-		log_error("XRANDR: <%d> (add_mode) [WARNING] mode already exist (duplicate request)\n", m_id);
-		mode->platform_data = pxmode->id;
-		return true;
-	}
+	sprintf(name, "SR-%d_%dx%d@%.02f%s_%08x", m_id, mode->hactive, mode->vactive, mode->vfreq, mode->interlace ? "i" : "", (unsigned int)modeline_timing_hash(mode));
 
 	log_verbose("XRANDR: <%d> (add_mode) create mode %s\n", m_id, name);
 
@@ -682,57 +675,54 @@ bool xrandr_timing::add_mode(modeline *mode)
 		}
 	}
 	else
+	{
+		map_mode(mode, mode->platform_data);
+		m_created_ids.insert(mode->platform_data);
 		log_verbose("XRANDR: <%d> (add_mode) mode %04lx %dx%d refresh %.6f added\n", m_id, mode->platform_data, mode->hactive, mode->vactive, mode->vfreq);
+	}
 
 	return ms_xerrors == 0;
 }
 
 //============================================================
-//  xrandr_timing::find_mode_by_name
+//  xrandr_timing::find_mode
 //============================================================
 
-XRRModeInfo *xrandr_timing::find_mode_by_name(char *name)
+RRMode xrandr_timing::find_mode(modeline *mode)
 {
-	XRRModeInfo *pxmode = NULL;
-	XRRScreenResources *resources = XRRGetScreenResourcesCurrent(m_pdisplay, m_root);
+	// Id of the output mode with these timings, 0 if there's none
+	auto it = m_mode_ids.find(modeline_timing_hash(mode));
+	return it != m_mode_ids.end()? it->second : 0;
+}
 
-	// use SR name to return the mode
-	for (int m = 0; m < resources->nmode; m++)
-	{
-		if (strcmp(resources->modes[m].name, name) == 0)
-		{
-			pxmode = &resources->modes[m];
-			break;
-		}
-	}
+//============================================================
+//  xrandr_timing::map_mode
+//============================================================
 
-	XRRFreeScreenResources(resources);
+void xrandr_timing::map_mode(modeline *mode, RRMode id)
+{
+	uint64_t hash = modeline_timing_hash(mode);
 
-	return pxmode;
+	m_mode_ids[hash] = id;
+	m_mode_hashes[id] = hash;
 }
 
 //============================================================
-//  xrandr_timing::find_mode
+//  xrandr_timing::unmap_mode
 //============================================================
 
-XRRModeInfo *xrandr_timing::find_mode(modeline *mode)
+void xrandr_timing::unmap_mode(RRMode id)
 {
-	XRRModeInfo *pxmode = NULL;
-	XRRScreenResources *resources = XRRGetScreenResourcesCurrent(m_pdisplay, m_root);
+	auto it = m_mode_hashes.find(id);
+	if (it == m_mode_hashes.end())
+		return;
 
-	// use platform_data (mode id) to return the mode
-	for (int m = 0; m < resources->nmode; m++)
-	{
-		if (mode->platform_data == resources->modes[m].id)
-		{
-			pxmode = &resources->modes[m];
-			break;
-		}
-	}
+	// Other modes with the same timings may have taken the hash over
+	auto mapped = m_mode_ids.find(it->second);
+	if (mapped != m_mode_ids.end() && mapped->second == id)
+		m_mode_ids.erase(mapped);
 
-	XRRFreeScreenResources(resources);
-
-	return pxmode;
+	m_mode_hashes.erase(it);
 }
 
 //============================================================
@@ -769,14 +759,19 @@ bool xrandr_timing::set_timing(modeline *mode, int flags)
 	if (m_id != 1 && (flags & XRANDR_ENABLE_SCREEN_REORDERING))
 		flags = XRANDR_DISABLE_CRTC_RELOCATION; // only master can do global screen preparation
 
-	XRRModeInfo *pxmode = NULL;
+	XRRModeInfo *pxmode = &m_desktop_mode;
+	XRRModeInfo xmode = {};
 
-	if (mode->type & MODE_DESKTOP)
-		pxmode = &m_desktop_mode;
-	else
-		pxmode = find_mode(mode);
+	if (!(mode->type & MODE_DESKTOP))
+	{
+		// Our mode id if the server still has it, otherwise the one of the same timings
+		xmode.id = m_mode_hashes.count(mode->platform_data)? mode->platform_data : find_mode(mode);
+		xmode.width = mode->hactive;
+		xmode.height = mode->vactive;
+		pxmode = &xmode;
+	}
 
-	if (pxmode == NULL)
+	if (pxmode->id == 0)
 	{
 		log_error("XRANDR: <%d> (set_timing) [ERROR] mode not found\n", m_id);
 		return false;
@@ -1037,48 +1032,59 @@ bool xrandr_timing::delete_mode(modeline *mode)
 	if (!mode)
 		return false;
 
+	// The mode id we were given, or else the one of the same timings. Its timings may
+	// have changed since it was added, update_mode deletes it with the new ones
+	RRMode id = m_mode_hashes.count(mode->platform_data)? mode->platform_data : find_mode(mode);
+	if (id == 0)
+		return true;
+
+	// Only the modes we created are ours to delete
+	if (!m_created_ids.count(id))
+	{
+		log_verbose("XRANDR: <%d> (delete_mode) mode [%04lx] wasn't created by us, keeping it\n", m_id, id);
+		mode->platform_data = 0;
+		return true;
+	}
+
 	XRRScreenResources *resources = XRRGetScreenResourcesCurrent(m_pdisplay, m_root);
 
 	int total_xerrors = 0;
 	// Delete modeline
-	for (int m = 0; m < resources->nmode && mode->platform_data != 0; m++)
-	{
-		if (mode->platform_data == resources->modes[m].id)
-		{
-			XRROutputInfo *output_info = XRRGetOutputInfo(m_pdisplay, resources, resources->outputs[m_desktop_output]);
-			XRRCrtcInfo *crtc_info = XRRGetCrtcInfo(m_pdisplay, resources, output_info->crtc);
-			if (resources->modes[m].id == crtc_info->mode)
-				log_verbose("XRANDR: <%d> (delete_mode) [WARNING] modeline [%04lx] is currently active\n", m_id, resources->modes[m].id);
+	XRROutputInfo *output_info = XRRGetOutputInfo(m_pdisplay, resources, resources->outputs[m_desktop_output]);
+	XRRCrtcInfo *crtc_info = XRRGetCrtcInfo(m_pdisplay, resources, output_info->crtc);
+	if (id == crtc_info->mode)
+		log_verbose("XRANDR: <%d> (delete_mode) [WARNING] modeline [%04lx] is currently active\n", m_id, id);
 
-			XRRFreeCrtcInfo(crtc_info);
-			XRRFreeOutputInfo(output_info);
+	XRRFreeCrtcInfo(crtc_info);
+	XRRFreeOutputInfo(output_info);
 
-			log_verbose("XRANDR: <%d> (delete_mode) remove mode %s\n", m_id, resources->modes[m].name);
+	log_verbose("XRANDR: <%d> (delete_mode) remove mode [%04lx] %dx%d refresh %.6f\n", m_id, id, mode->hactive, mode->vactive, mode->vfreq);
 
-			XSync(m_pdisplay, False);
-			ms_xerrors = 0;
-			ms_xerrors_flag = 0x01;
-			old_error_handler = XSetErrorHandler(error_handler);
-			XRRDeleteOutputMode(m_pdisplay, resources->outputs[m_desktop_output], resources->modes[m].id);
-			if (ms_xerrors & ms_xerrors_flag)
-			{
-				log_error("XRANDR: <%d> (delete_mode) [ERROR] in %s\n", m_id, "XRRDeleteOutputMode");
-				total_xerrors++;
-			}
+	XSync(m_pdisplay, False);
+	ms_xerrors = 0;
+	ms_xerrors_flag = 0x01;
+	old_error_handler = XSetErrorHandler(error_handler);
+	XRRDeleteOutputMode(m_pdisplay, resources->outputs[m_desktop_output], id);
+	if (ms_xerrors & ms_xerrors_flag)
+	{
+		log_error("XRANDR: <%d> (delete_mode) [ERROR] in %s\n", m_id, "XRRDeleteOutputMode");
+		total_xerrors++;
+	}
 
-			ms_xerrors_flag = 0x02;
-			XRRDestroyMode(m_pdisplay, resources->modes[m].id);
-			XSync(m_pdisplay, False);
-			XSetErrorHandler(old_error_handler);
-			if (ms_xerrors & ms_xerrors_flag)
-			{
-				log_error("XRANDR: <%d> (delete_mode) [ERROR] in %s\n", m_id, "XRRDestroyMode");
-				total_xerrors++;
-			}
-			mode->platform_data = 0;
-		}
+	ms_xerrors_flag = 0x02;
+	XRRDestroyMode(m_pdisplay, id);
+	XSync(m_pdisplay, False);
+	XSetErrorHandler(old_error_handler);
+	if (ms_xerrors & ms_xerrors_flag)
+	{
+		log_error("XRANDR: <%d> (delete_mode) [ERROR] in %s\n", m_id, "XRRDestroyMode");
+		total_xerrors++;
 	}
 
+	unmap_mode(id);
+	m_created_ids.erase(id);
+	mode->platform_data = 0;
+
 	XRRFreeScreenResources(resources);
 
 	return total_xerrors == 0;
@@ -1100,6 +1106,13 @@ bool xrandr_timing::get_timing(modeline *mode)
 	XRRScreenResources *resources = XRRGetScreenResourcesCurrent(m_pdisplay, m_root);
 	XRROutputInfo *output_info = XRRGetOutputInfo(m_pdisplay, resources, resources->outputs[m_desktop_output]);
 
+	// A new listing, map the output's modes again
+	if (m_video_modes_position == 0)
+	{
+		m_mode_ids.clear();
+		m_mode_hashes.clear();
+	}
+
 	// Cycle through the modelines and report them back to the display manager
 	if (m_video_modes_position < output_info->nmode)
 	{
@@ -1144,6 +1157,8 @@ bool xrandr_timing::get_timing(modeline *mode)
 				if (m_desktop_mode.id == pxmode->id)
 					mode->type |= MODE_DESKTOP;
 
+				map_mode(mode, pxmode->id);
+
 				log_verbose("XRANDR: <%d> (get_timing) mode %04lx %dx%d refresh %.6f added\n", m_id, pxmode->id, pxmode->width, pxmode->height, mode->vfreq);
 			}
 		}
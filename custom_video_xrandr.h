@@ -15,6 +15,9 @@
 #ifndef __CUSTOM_VIDEO_XRANDR__
 #define __CUSTOM_VIDEO_XRANDR__
 
+#include <unordered_map>
+#include <unordered_set>
+
 // X11 Xrandr headers
 #include <X11/extensions/Xrandr.h>
 #include "custom_video.h"
@@ -44,6 +47,8 @@ class xrandr_timing : public custom_video
 		~xrandr_timing();
 		const char *api_name() { return "XRANDR"; }
 		int caps() { return CUSTOM_VIDEO_CAPS_ADD; }
+		// The server drivers keep the clock in kHz, 16-bit timings
+		timing_constraints constraints() { return { 1000, 0, 0, 0, 65535, 65535 }; }
 		bool init();
 
 		bool add_mode(modeline *mode);
@@ -64,8 +69,9 @@ class xrandr_timing : public custom_video
 		int m_enable_screen_reordering = 0;
 		int m_enable_screen_compositing = 0;
 
-		XRRModeInfo *find_mode(modeline *mode);
-		XRRModeInfo *find_mode_by_name(char *name);
+		RRMode find_mode(modeline *mode);
+		void map_mode(modeline *mode, RRMode id);
+		void unmap_mode(RRMode id);
 
 		bool set_timing(modeline *mode, int flags);
 
@@ -87,6 +93,13 @@ class xrandr_timing : public custom_video
 
 		XRRCrtcInfo m_last_crtc = {};
 
+		// Ids of the output's modes by timing hash, and back
+		std::unordered_map<uint64_t, RRMode> m_mode_ids;
+		std::unordered_map<RRMode, uint64_t> m_mode_hashes;
+
+		// Ids of the modes we created, the only ones we delete
+		std::unordered_set<RRMode> m_created_ids;
+
 		void *m_xrandr_handle = 0;
 
 		__typeof__(XRRAddOutputMode) *p_XRRAddOutputMode;
@@ -13,11 +13,16 @@
  **************************************************************/
 
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <algorithm>
+#include <atomic>
 #include "display.h"
+#include "work_pool.h"
 #if defined(_WIN32)
 #include "display_windows.h"
 #elif defined(__linux__)
-#include <string.h>
 #include "display_linux.h"
 #endif
 #ifdef SR_WITH_SDL2
@@ -100,6 +105,50 @@ void display_manager::parse_options()
 		else if (monitor_set_preset(m_ds.monitor, range) == 0)
 			monitor_set_preset(default_monitor, range);
 	}
+
+	update_ranges();
+	update_constraints();
+}
+
+//============================================================
+//  display_manager::update_ranges
+//============================================================
+
+void display_manager::update_ranges()
+{
+	range_set_build(&m_range_set, range);
+
+	// Size the lookup tables first, ranges that would take us over our budget go without one
+	size_t entries[MAX_RANGES];
+	size_t total = 0;
+	for (int i = 0; i < MAX_RANGES; i++)
+	{
+		range[i].lut = nullptr;
+		entries[i] = range_lut_entries(&range[i]);
+
+		if ((total + entries[i]) * sizeof(double) > RANGE_LUT_MAX_BYTES)
+		{
+			log_verbose("Switchres: range %d lookup table skipped, over %d bytes\n", i, RANGE_LUT_MAX_BYTES);
+			entries[i] = 0;
+		}
+		total += entries[i];
+	}
+
+	m_range_lut_data.assign(total, 0);
+
+	int tables = 0;
+	size_t offset = 0;
+	for (int i = 0; i < MAX_RANGES; i++)
+	{
+		if (!entries[i])
+			continue;
+
+		range_lut_build(&m_range_lut[i], &range[i], &m_range_lut_data[offset]);
+		offset += entries[i];
+		tables++;
+	}
+
+	log_verbose("Switchres: range lookup tables: %d, %d bytes\n", tables, int(total * sizeof(double)));
 }
 
 //============================================================
@@ -111,19 +160,65 @@ bool display_manager::init(void* pf_data)
 	sprintf(m_ds.screen, "ram");
 	m_pf_data = pf_data;
 
+	open_mode_cache();
+
 	return true;
 }
 
+//============================================================
+//  display_manager::open_mode_cache
+//============================================================
+
+void display_manager::open_mode_cache()
+{
+	// Map our persistent mode cache, if any. Its header hashes our settings,
+	// backend constraints included, so it goes after update_constraints
+	if (strcmp(m_ds.mode_cache, "none") && m_ds.mode_cache[0])
+		m_mode_cache_file.open(m_ds.mode_cache, settings_hash());
+}
+
 //============================================================
 //  display_manager::caps
 //============================================================
 
 int display_manager::caps()
+{
+	// Read from the backend once, it's asked for on every mode
+	if (m_caps < 0)
+		m_caps = video()? video()->caps() : CUSTOM_VIDEO_CAPS_ADD;
+
+	return m_caps;
+}
+
+//============================================================
+//  display_manager::constraints
+//============================================================
+
+timing_constraints display_manager::constraints()
 {
 	if (video())
-		return video()->caps();
+		return video()->constraints();
 	else
-		return CUSTOM_VIDEO_CAPS_ADD;
+		return {};
+}
+
+//============================================================
+//  display_manager::update_constraints
+//============================================================
+
+void display_manager::update_constraints()
+{
+	// Have the generator honour our backend's timing limits, must be
+	// called again once the backend is initialized
+	m_ds.gs.constraints = constraints();
+
+	// Same for its capabilities
+	m_caps = -1;
+
+	timing_constraints *tc = &m_ds.gs.constraints;
+	if (tc->pclock_quantum || tc->pclock_min || tc->pclock_max || tc->htotal_align || tc->htotal_max || tc->vtotal_max)
+		log_verbose("Switchres: backend timing constraints: pclock step %d Hz, pclock %d-%d Hz, htotal align %d, htotal max %d, vtotal max %d\n",
+			int(tc->pclock_quantum), int(tc->pclock_min), int(tc->pclock_max), tc->htotal_align, tc->htotal_max, tc->vtotal_max);
 }
 
 //============================================================
@@ -196,6 +291,49 @@ bool display_manager::update_mode(modeline *mode)
 	return true;
 }
 
+//============================================================
+//  display_manager::adjust_geometry
+//============================================================
+
+bool display_manager::adjust_geometry(double h_size, int h_shift, int v_shift)
+{
+	// Apply new geometry values to the best mode without searching it again: we start
+	// from the mode as it was solved and keep its vertical solution. The new timings go
+	// to the mode entry, flagged for update_mode if it's already in the driver
+	set_h_size(h_size);
+	set_h_shift(h_shift);
+	set_v_shift(v_shift);
+
+	if (best_mode() == nullptr || !(m_geometry_base.type & V_FREQ_EDITABLE))
+		return false;
+
+	modeline mode = modeline_adjust_geometry(&m_geometry_base, range[m_geometry_base.range].hfreq_max, &m_ds.gs, &m_ds.gs);
+	if (mode.result.weight & R_OUT_OF_RANGE)
+	{
+		log_error("Switchres: geometry (%.3f:%d:%d) can't be applied to the current mode\n", h_size, h_shift, v_shift);
+		return false;
+	}
+
+	finish_refresh(&mode, m_geometry_base.vfreq / (1.0 + m_geometry_base.result.v_ppm / 1e6), &m_ds.gs);
+
+	// Only the timings change, the entry keeps its identity and state
+	journal_update(video_modes.index(m_best_mode));
+
+	modeline *best = best_mode();
+	modeline previous = *best;
+	memcpy(best, &mode, offsetof(modeline, width));
+	best->result.v_ppm = mode.result.v_ppm;
+
+	if (!(best->type & MODE_ADD) && modeline_is_different(best, &previous))
+	{
+		best->type |= MODE_UPDATE;
+		m_switching_required = true;
+	}
+
+	log_verbose("Switchres: geometry adjusted (%.3f:%d:%d)\n", m_ds.gs.h_size, m_ds.gs.h_shift, m_ds.gs.v_shift);
+	return true;
+}
+
 //============================================================
 //  display_manager::set_mode
 //============================================================
@@ -221,22 +359,197 @@ void display_manager::log_mode(modeline *mode)
 
 bool display_manager::restore_modes()
 {
-	// Compare each mode in our table with its original state
-	for (unsigned i = video_modes.size(); i-- > 0; )
+	// Undo our changes to the mode list, latest first
+	for (size_t c = m_mode_journal.size(); c-- > 0; )
 	{
-		// First, delete all modes we've added
-		if (i + 1 > backup_modes.size())
+		const mode_change &change = m_mode_journal[c];
+		int i = video_modes.index(change.handle);
+
+		// Put back the modes we've deleted
+		if (change.type == MODE_DELETE)
+		{
+			video_modes.push_back(change.original);
+			video_modes.back().type &= ~(MODE_UPDATE | MODE_DELETE | MODE_ERROR);
+			video_modes.back().type |= MODE_ADD;
+		}
+
+		// Entries gone since then need nothing
+		else if (i < 0)
+			continue;
+
+		// Delete all modes we've added
+		else if (change.type == MODE_ADD)
 			video_modes[i].type |= MODE_DELETE;
 
-		// Now restore all modes which timings have been modified
-		else if (modeline_is_different(&video_modes[i], &backup_modes[i]))
+		// Restore all modes which timings have been modified
+		else if (modeline_is_different(&video_modes[i], &change.original))
 		{
-			video_modes[i] = backup_modes[i];
+			video_modes[i] = change.original;
 			video_modes[i].type |= MODE_UPDATE;
+			table_changed(i);
+			reindex_mode(i);
 		}
 	}
+
 	// Finally, flush pending changes to driver
-	return flush_modes();
+	bool result = flush_modes();
+
+	for (auto &change : m_mode_journal)
+		if (video_modes.index(change.handle) >= 0)
+			video_modes.set_mark(video_modes.index(change.handle), -1);
+
+	m_mode_journal.clear();
+	return result;
+}
+
+//============================================================
+//  display_manager::journal_add
+//============================================================
+
+void display_manager::journal_add(int i)
+{
+	// Entry i was added by us
+	if (m_mode_journal.size() >= m_journal_limit)
+		compact_journal();
+
+	video_modes.set_mark(i, m_mode_journal.size());
+	m_mode_journal.push_back({ MODE_ADD, video_modes.handle(i), {} });
+}
+
+//============================================================
+//  display_manager::journal_update
+//============================================================
+
+void display_manager::journal_update(int i)
+{
+	// Entry i is about to change, only its first change is kept
+	table_changed(i);
+	if (video_modes.mark(i) >= 0)
+		return;
+
+	if (m_mode_journal.size() >= m_journal_limit)
+		compact_journal();
+
+	video_modes.set_mark(i, m_mode_journal.size());
+	m_mode_journal.push_back({ MODE_UPDATE, video_modes.handle(i), video_modes[i] });
+}
+
+//============================================================
+//  display_manager::journal_delete
+//============================================================
+
+void display_manager::journal_delete(int i)
+{
+	// Entry i is leaving the list. If it's one we added there's nothing to
+	// put back, otherwise it's put back as it was before our first change
+	int c = video_modes.mark(i);
+	if (c >= 0 && m_mode_journal[c].type == MODE_ADD)
+		return;
+
+	m_mode_journal.push_back({ MODE_DELETE, {}, c >= 0? m_mode_journal[c].original : video_modes[i] });
+}
+
+//============================================================
+//  display_manager::compact_journal
+//============================================================
+
+void display_manager::compact_journal()
+{
+	// Drop the records of entries no longer in the list. Nothing is left to
+	// undo for them, the ones flush_modes deleted have a MODE_DELETE record
+	size_t kept = 0;
+
+	for (auto &change : m_mode_journal)
+	{
+		int i = video_modes.index(change.handle);
+		if (change.type != MODE_DELETE && i < 0)
+			continue;
+
+		if (i >= 0)
+			video_modes.set_mark(i, kept);
+
+		m_mode_journal[kept++] = change;
+	}
+
+	m_mode_journal.resize(kept);
+	m_journal_limit = std::max(size_t(MODE_JOURNAL_SLACK), kept * 2);
+}
+
+//============================================================
+//  display_manager::is_own_mode
+//============================================================
+
+bool display_manager::is_own_mode(int i)
+{
+	// Entry i was added by us
+	int c = video_modes.mark(i);
+	return c >= 0 && m_mode_journal[c].type == MODE_ADD;
+}
+
+//============================================================
+//  display_manager::pool_mode
+//============================================================
+
+void display_manager::pool_mode(int i)
+{
+	// Entry i just reached the driver
+	if (m_ds.mode_pool > 0 && is_own_mode(i))
+		m_mode_pool.push_back({ video_modes.handle(i), ++m_mode_pool_clock });
+}
+
+//============================================================
+//  display_manager::touch_mode
+//============================================================
+
+void display_manager::touch_mode(int i)
+{
+	mode_handle handle = video_modes.handle(i);
+
+	for (auto &pooled : m_mode_pool)
+		if (pooled.handle.slot == handle.slot && pooled.handle.generation == handle.generation)
+			pooled.last_used = ++m_mode_pool_clock;
+}
+
+//============================================================
+//  display_manager::evict_modes
+//============================================================
+
+int display_manager::evict_modes(int count)
+{
+	// Flag the count least recently used modes of our pool for deletion, but
+	// not the best or current ones. Returns how many were flagged
+	int evicted = 0;
+	size_t kept = 0;
+
+	for (auto &pooled : m_mode_pool)
+		if (video_modes.index(pooled.handle) >= 0)
+			m_mode_pool[kept++] = pooled;
+
+	m_mode_pool.resize(kept);
+	if (count <= 0)
+		return 0;
+
+	std::sort(m_mode_pool.begin(), m_mode_pool.end(), [](const pooled_mode &a, const pooled_mode &b) { return a.last_used < b.last_used; });
+
+	int best = video_modes.index(m_best_mode);
+	int current = video_modes.index(m_current_mode);
+	kept = 0;
+
+	for (auto &pooled : m_mode_pool)
+	{
+		int i = video_modes.index(pooled.handle);
+		if (evicted < count && i != best && i != current)
+		{
+			video_modes[i].type |= MODE_DELETE;
+			evicted++;
+		}
+		else
+			m_mode_pool[kept++] = pooled;
+	}
+
+	m_mode_pool.resize(kept);
+	log_verbose("Switchres: %d modes evicted from our pool of %d\n", evicted, m_ds.mode_pool);
+	return evicted;
 }
 
 //============================================================
@@ -251,6 +564,17 @@ bool display_manager::flush_modes()
 	if (video() == nullptr)
 		return false;
 
+	// Make room in our pool for the modes we're adding, in the same batch
+	if (m_ds.mode_pool > 0)
+	{
+		int adding = 0;
+		for (unsigned i = 0; i < video_modes.size(); i++)
+			if ((video_modes[i].type & MODE_ADD) && is_own_mode(i))
+				adding++;
+
+		evict_modes(m_mode_pool.size() + adding - m_ds.mode_pool);
+	}
+
 	// Loop through our mode table to collect all pending changes
 	for (auto &mode : video_modes)
 		if (mode.type & (MODE_UPDATE | MODE_ADD | MODE_DELETE))
@@ -271,7 +595,9 @@ bool display_manager::flush_modes()
 				error = true;
 		}
 
-		// Update our internal mode table to reflect the changes
+		// Update our internal mode table to reflect the changes, the deleted
+		// entries leave the list together
+		std::vector<int> deleted;
 		for (unsigned i = video_modes.size(); i-- > 0; )
 		{
 			if (video_modes[i].type & MODE_ERROR)
@@ -279,12 +605,20 @@ bool display_manager::flush_modes()
 
 			if (video_modes[i].type & MODE_DELETE)
 			{
-				video_modes.erase(video_modes.begin() + i);
-				m_best_mode = 0;
+				journal_delete(i);
+				deleted.push_back(i);
 			}
 			else
+			{
+				if (video_modes[i].type & MODE_ADD)
+					pool_mode(i);
+
 				video_modes[i].type &= ~(MODE_UPDATE | MODE_ADD);
+			}
 		}
+
+		std::reverse(deleted.begin(), deleted.end());
+		erase_modes(deleted);
 	}
 
 	return !error;
@@ -296,22 +630,24 @@ bool display_manager::flush_modes()
 
 bool display_manager::filter_modes()
 {
+	int mode_caps = caps();
+
 	for (auto &mode : video_modes)
 	{
 		// apply options to mode type
 		if (m_ds.refresh_dont_care)
 			mode.type |= V_FREQ_EDITABLE;
 
-		if ((caps() & CUSTOM_VIDEO_CAPS_UPDATE))
+		if (mode_caps & CUSTOM_VIDEO_CAPS_UPDATE)
 			mode.type |= V_FREQ_EDITABLE;
 
-		if (caps() & CUSTOM_VIDEO_CAPS_SCAN_EDITABLE)
+		if (mode_caps & CUSTOM_VIDEO_CAPS_SCAN_EDITABLE)
 			mode.type |= SCAN_EDITABLE;
 
 		if (!m_ds.modeline_generation)
 			mode.type &= ~(XYV_EDITABLE | SCAN_EDITABLE);
 
-		if ((mode.type & MODE_DESKTOP) && !(caps() & CUSTOM_VIDEO_CAPS_DESKTOP_EDITABLE))
+		if ((mode.type & MODE_DESKTOP) && !(mode_caps & CUSTOM_VIDEO_CAPS_DESKTOP_EDITABLE))
 			mode.type &= ~V_FREQ_EDITABLE;
 
 		if (m_ds.lock_system_modes && (mode.type & CUSTOM_VIDEO_TIMING_SYSTEM))
@@ -333,142 +669,1572 @@ bool display_manager::filter_modes()
 		}
 	}
 
+	index_modes();
 	return true;
 }
 
 //============================================================
-//  display_manager::get_video_mode
+//  resolution_key
 //============================================================
 
-modeline *display_manager::get_mode(int width, int height, float refresh, bool interlaced)
+static uint64_t resolution_key(int width, int height)
 {
-	modeline s_mode = {};
-	modeline t_mode = {};
-	modeline best_mode = {};
-	char result[256]={'\x00'};
+	return uint64_t(uint32_t(width)) << 32 | uint32_t(height);
+}
 
-	log_verbose("Switchres: Calculating best video mode for %dx%d@%.6f%s orientation: %s\n",
-						width, height, refresh, interlaced?"i":"", rotation()?"rotated":"normal");
+//============================================================
+//  insert_index
+//============================================================
 
-	best_mode.result.weight |= R_OUT_OF_RANGE;
+static void insert_index(std::vector<int> &list, int i)
+{
+	auto it = std::lower_bound(list.begin(), list.end(), i);
+	if (it == list.end() || *it != i)
+		list.insert(it, i);
+}
+
+//============================================================
+//  erase_index
+//============================================================
+
+static void erase_index(std::vector<int> &list, int i)
+{
+	auto it = std::lower_bound(list.begin(), list.end(), i);
+	if (it != list.end() && *it == i)
+		list.erase(it);
+}
 
-	s_mode.interlace = interlaced;
-	s_mode.vfreq = refresh;
+//============================================================
+//  move_index
+//============================================================
+
+static void move_index(std::vector<int> &list, const std::vector<int> &moved)
+{
+	// Entries only move down and keep their order, so the list stays sorted
+	size_t kept = 0;
+	for (int i : list)
+		if (moved[i] >= 0)
+			list[kept++] = moved[i];
 
-	s_mode.hactive = normalize(width, 8);
-	s_mode.vactive = height;
+	list.resize(kept);
+}
 
-	if (rotation()) std::swap(s_mode.hactive, s_mode.vactive);
+//============================================================
+//  display_manager::index_modes
+//============================================================
 
-	// Create a dummy mode entry if allowed
-	if (caps() & CUSTOM_VIDEO_CAPS_ADD && m_ds.modeline_generation)
+void display_manager::index_modes()
+{
+	// The list is filed from scratch, shorter lists it had aren't coming back
+	m_mode_index.clear();
+	m_mode_keys.clear();
+	m_unlocked_modes.clear();
+	m_shorter_generations.clear();
+	sync_mode_index();
+}
+
+//============================================================
+//  display_manager::sync_mode_index
+//============================================================
+
+void display_manager::sync_mode_index()
+{
+	// Pick up entries appended to or dropped from the end of the list
+	while (m_mode_keys.size() > video_modes.size())
 	{
-		modeline new_mode = {};
-		new_mode.type = XYV_EDITABLE | V_FREQ_EDITABLE | SCAN_EDITABLE | MODE_ADD | (desktop_is_rotated()? MODE_ROTATED : MODE_OK);
-		video_modes.push_back(new_mode);
+		unindex_mode(m_mode_keys.size() - 1);
+		m_mode_keys.pop_back();
+		table_truncated(m_mode_keys.size());
 	}
 
-	// Run through our mode list and find the most suitable mode
-	for (auto &mode : video_modes)
+	while (m_mode_keys.size() < video_modes.size())
 	{
-		log_verbose("\nSwitchres: %s%4d%sx%s%4d%s_%s%d=%.6fHz%s%s\n",
-			mode.type & X_RES_EDITABLE?"(":"[", mode.width, mode.type & X_RES_EDITABLE?")":"]",
-			mode.type & Y_RES_EDITABLE?"(":"[", mode.height, mode.type & Y_RES_EDITABLE?")":"]",
-			mode.type & V_FREQ_EDITABLE?"(":"[", mode.refresh, mode.vfreq, mode.type & V_FREQ_EDITABLE?")":"]",
-			mode.type & MODE_DISABLED?" - locked":"");
-
-		// now get the mode if allowed
-		if (!(mode.type & MODE_DISABLED))
-		{
-			for (int i = 0 ; i < MAX_RANGES ; i++)
-			{
-				if (range[i].hfreq_min)
-				{
-					t_mode = mode;
-
-					// init all editable fields with source or user values
-					if (t_mode.type & X_RES_EDITABLE)
-						t_mode.hactive = m_user_mode.width? m_user_mode.width : s_mode.hactive;
-
-					if (t_mode.type & Y_RES_EDITABLE)
-						t_mode.vactive = m_user_mode.height? m_user_mode.height : s_mode.vactive;
-
-					if (t_mode.type & V_FREQ_EDITABLE)
-					{
-						// If user's vfreq is defined, it means we have an user modeline, so force it
-						if (m_user_mode.vfreq)
-						{
-							int t_type = t_mode.type;
-							t_mode = m_user_mode;
-							t_mode.type = t_type;
-						}
-						else
-							t_mode.vfreq = s_mode.vfreq;
-					}
-
-					// lock resolution fields if required
-					if (m_user_mode.width) t_mode.type &= ~X_RES_EDITABLE;
-					if (m_user_mode.height) t_mode.type &= ~Y_RES_EDITABLE;
-					if (m_user_mode.vfreq) t_mode.type &= ~V_FREQ_EDITABLE;
-
-					modeline_create(&s_mode, &t_mode, &range[i], &m_ds.gs);
-					t_mode.range = i;
-
-					log_verbose("%s\n", modeline_result(&t_mode, result));
-
-					if (modeline_compare(&t_mode, &best_mode))
-					{
-						best_mode = t_mode;
-						m_best_mode = &mode;
-					}
-				}
-			}
-		}
+		m_shorter_generations.push_back({ m_mode_keys.size(), m_table_generation });
+		m_table_generation = ++m_table_generations;
+		m_mode_keys.push_back(0);
+		index_mode(m_mode_keys.size() - 1);
 	}
+}
+
+//============================================================
+//  display_manager::index_mode
+//============================================================
+
+void display_manager::index_mode(int i)
+{
+	const modeline &mode = video_modes[i];
 
-	// If we didn't need to create a new mode, remove our dummy entry
-	if (caps() & CUSTOM_VIDEO_CAPS_ADD && m_ds.modeline_generation && m_best_mode != &video_modes.back())
-		video_modes.pop_back();
+	m_mode_keys[i] = resolution_key(mode.width, mode.height);
+	insert_index(m_mode_index[m_mode_keys[i]], i);
 
-	// If we didn't find a suitable mode, exit now
-	if (best_mode.result.weight & R_OUT_OF_RANGE)
+	if (!(mode.type & MODE_DISABLED))
+		insert_index(m_unlocked_modes, i);
+}
+
+//============================================================
+//  display_manager::unindex_mode
+//============================================================
+
+void display_manager::unindex_mode(int i)
+{
+	// Emptied lists are kept, the same resolution is likely to be added again
+	auto entry = m_mode_index.find(m_mode_keys[i]);
+	if (entry != m_mode_index.end())
+		erase_index(entry->second, i);
+
+	erase_index(m_unlocked_modes, i);
+}
+
+//============================================================
+//  display_manager::reindex_mode
+//============================================================
+
+void display_manager::reindex_mode(int i)
+{
+	// Entry i was overwritten, file it again if its resolution or lock changed
+	sync_mode_index();
+
+	const modeline &mode = video_modes[i];
+	bool unlocked = std::binary_search(m_unlocked_modes.begin(), m_unlocked_modes.end(), i);
+	if (m_mode_keys[i] == resolution_key(mode.width, mode.height) && unlocked == !(mode.type & MODE_DISABLED))
+		return;
+
+	unindex_mode(i);
+	index_mode(i);
+}
+
+//============================================================
+//  display_manager::table_changed
+//============================================================
+
+void display_manager::table_changed(size_t i)
+{
+	// Entries from i on changed, the generations of lists up to i entries long still hold
+	while (!m_shorter_generations.empty() && m_shorter_generations.back().first > i)
+		m_shorter_generations.pop_back();
+
+	m_table_generation = ++m_table_generations;
+}
+
+//============================================================
+//  display_manager::table_truncated
+//============================================================
+
+void display_manager::table_truncated(size_t size)
+{
+	// The list lost its last entry, it's back as it was at this size if only
+	// entries after that changed since
+	if (!m_shorter_generations.empty() && m_shorter_generations.back().first == size)
 	{
-		m_best_mode = 0;
-		log_error("Switchres: could not find a video mode that meets your specs\n");
-		return nullptr;
+		m_table_generation = m_shorter_generations.back().second;
+		m_shorter_generations.pop_back();
 	}
+	else
+		table_changed(size);
+}
 
-	if ((best_mode.type & V_FREQ_EDITABLE) && !(best_mode.result.weight & R_OUT_OF_RANGE))
-		modeline_adjust(&best_mode, range[best_mode.range].hfreq_max, &m_ds.gs);
+//============================================================
+//  display_manager::erase_mode
+//============================================================
 
-	log_verbose("\nSwitchres: %s (%dx%d@%.6f)->(%dx%d@%.6f)\n", rotation()?"rotated":"normal",
-		width, height, refresh, best_mode.hactive, best_mode.vactive, best_mode.vfreq);
+void display_manager::erase_mode(int i)
+{
+	erase_modes({ i });
+}
 
-	log_verbose("%s\n", modeline_result(&best_mode, result));
+//============================================================
+//  display_manager::erase_modes
+//============================================================
 
-	// Copy the new modeline to our mode list
-	if (m_ds.modeline_generation)
+void display_manager::erase_modes(const std::vector<int> &list)
+{
+	// The entries in list, ascending, leave the list. The ones after them
+	// move down in the list, not in memory, and the index is updated once
+	if (list.empty())
+		return;
+
+	sync_mode_index();
+	size_t size = video_modes.size();
+	bool tail = list.front() == (int)(size - list.size());
+	video_modes.erase(list);
+
+	// New position of each entry, -1 for the ones that left
+	std::vector<int> moved(size);
+	size_t e = 0, kept = 0;
+	for (size_t i = 0; i < size; i++)
 	{
-		if (best_mode.type & MODE_ADD)
+		if (e < list.size() && list[e] == (int)i)
 		{
-			best_mode.width = best_mode.hactive;
-			best_mode.height = best_mode.vactive;
-			best_mode.refresh = int(best_mode.vfreq);
-			// lock new mode
-			best_mode.type &= ~(X_RES_EDITABLE | Y_RES_EDITABLE);
+			moved[i] = -1;
+			e++;
+			continue;
 		}
-		else if (modeline_is_different(&best_mode, m_best_mode) != 0)
-			best_mode.type |= MODE_UPDATE;
 
-		char modeline[256]={'\x00'};
-		log_info("Switchres: Modeline %s\n", modeline_print(&best_mode, modeline, MS_FULL));
+		moved[i] = kept;
+		m_mode_keys[kept++] = m_mode_keys[i];
 	}
+	m_mode_keys.resize(kept);
 
-	// Check if new best mode is different than previous one
-	m_switching_required = (m_current_mode != m_best_mode || best_mode.type & MODE_UPDATE);
+	for (auto &entry : m_mode_index)
+		move_index(entry.second, moved);
+
+	move_index(m_unlocked_modes, moved);
+
+	// Dropping entries from the end gives back the shorter list's generation
+	if (tail)
+		for (size_t s = size; s-- > kept; )
+			table_truncated(s);
+	else
+		table_changed(list.front());
+}
+
+//============================================================
+//  display_manager::find_mode
+//============================================================
+
+int display_manager::find_mode(int width, int height, int refresh, bool interlace)
+{
+	// Lowest index of the entry with these values, or -1 if there's none
+	sync_mode_index();
+
+	auto entry = m_mode_index.find(resolution_key(width, height));
+	if (entry == m_mode_index.end())
+		return -1;
+
+	for (int m : entry->second)
+		if (video_modes[m].refresh == refresh && (video_modes[m].interlace != 0) == interlace)
+			return m;
+
+	return -1;
+}
+
+//============================================================
+//  display_manager::get_video_mode
+//============================================================
+
+modeline *display_manager::get_mode(int width, int height, float refresh, bool interlaced)
+{
+	mode_request request = { width, height, refresh, interlaced };
+	return solve_mode(request, nullptr);
+}
+
+modeline *display_manager::get_mode(int width, int height, float refresh, bool interlaced, std::chrono::steady_clock::time_point deadline, bool *complete)
+{
+	// Same as above, but the search stops at the deadline and the best mode
+	// found so far is used. Likely winners are tried first. If the search
+	// didn't finish, complete is set to false and the result isn't cached
+	mode_request request = { width, height, refresh, interlaced };
+	mode_budget budget = { deadline, true };
+
+	modeline *mode = solve_mode(request, &budget);
+	if (complete != nullptr)
+		*complete = budget.complete;
+
+	return mode;
+}
+
+//============================================================
+//  display_manager::solve_mode
+//============================================================
+
+modeline *display_manager::solve_mode(const mode_request &request, mode_budget *budget)
+{
+	int width = request.width;
+	int height = request.height;
+	float refresh = request.refresh;
+	bool interlaced = request.interlace;
+	modeline best_mode = {};
+	modeline base_mode = {};
+	int best_index = -1;
+	char result[256]={'\x00'};
+
+	log_verbose("Switchres: Calculating best video mode for %dx%d@%.6f%s orientation: %s\n",
+						width, height, refresh, interlaced?"i":"", rotation()?"rotated":"normal");
+
+	m_trace_count = 0;
+	sync_mode_index();
+
+	// Check if we already solved this request with the same settings and mode list
+	uint64_t search = search_hash();
+	uint64_t cache_key = mode_cache_key(request, search);
+	auto cached = m_mode_cache.find(cache_key);
+	bool stored_result = false;
+	bool reused = false;
+
+	if (cached != m_mode_cache.end() && cached->second.request.width == width && cached->second.request.height == height
+		&& cached->second.request.refresh == refresh && cached->second.request.interlace == interlaced)
+	{
+		m_mode_cache_hits++;
+		best_index = cached->second.best_index;
+		best_mode = cached->second.best_mode;
+		base_mode = cached->second.base_mode;
+		m_ds.gs = cached->second.gs;
+		stored_result = true;
+		log_verbose("Switchres: using cached result\n");
+	}
+	else
+	{
+		// The file is keyed on the mode list contents, only hashed on a miss.
+		// Timings rejected by the backend are this session's, results that
+		// avoided them stay out of the file
+		bool use_file = m_mode_cache_file.is_open() && m_rejected_timings.empty();
+		uint64_t file_key = use_file? mode_file_key(request, search) : 0;
+		const mode_cache_entry *stored = use_file? m_mode_cache_file.find(file_key, request) : nullptr;
+		bool searched = false;
+		if (stored != nullptr)
+		{
+			m_mode_cache_hits++;
+			best_index = stored->best_index;
+			best_mode = stored->best_mode;
+			base_mode = stored->base_mode;
+			m_ds.gs = stored->gs;
+			stored_result = true;
+			log_verbose("Switchres: using result from %s\n", m_ds.mode_cache);
+		}
+		else
+		{
+			m_mode_cache_misses++;
+			best_index = refresh_only_mode(request, search, &best_mode);
+			if (best_index < 0)
+			{
+				best_index = budget? find_best_mode(request, &best_mode, &m_ds.gs, caps(), m_trace_enabled, nullptr, 0, budget) : find_best_mode_parallel(request, &best_mode, &m_ds.gs, caps());
+				searched = true;
+			}
+			if (best_index >= 0)
+			{
+				finish_mode(&best_mode, best_index < (int)video_modes.size()? &video_modes[best_index] : nullptr, &m_ds.gs, &base_mode);
+				int found_index = best_index;
+				best_index = reuse_mode(best_index, &best_mode);
+				reused = best_index != found_index;
+			}
+		}
+
+		// An unfinished search must not be reused
+		if (budget == nullptr || budget->complete)
+		{
+			if (m_mode_cache.size() >= MODE_CACHE_SIZE)
+				m_mode_cache.clear();
+
+			// The refresh only shortcut depends on the entry we last used, only
+			// full searches are good for another session
+			m_mode_cache[cache_key] = { request, best_index, best_mode, base_mode, m_ds.gs };
+			if (use_file && searched)
+				m_mode_cache_file.append(file_key, &m_mode_cache[cache_key]);
+		}
+	}
+
+	// A stored result was flagged against its entry as it was then, flushes
+	// since may have cleared the entry's pending flags, and may come from
+	// another session where the backend had its own id for the mode
+	if (stored_result && best_index >= 0 && best_index < (int)video_modes.size())
+	{
+		const modeline *entry = &video_modes[best_index];
+		best_mode.type = (best_mode.type & ~(MODE_ADD | MODE_UPDATE)) | (entry->type & (MODE_ADD | MODE_UPDATE));
+		best_mode.platform_data = entry->platform_data;
+		if (m_ds.modeline_generation && !(best_mode.type & MODE_ADD) && modeline_is_different(&best_mode, entry))
+			best_mode.type |= MODE_UPDATE;
+	}
+	else if (stored_result && best_index == (int)video_modes.size())
+		best_mode.platform_data = 0;
+
+	// If we didn't find a suitable mode, exit now
+	if (best_index < 0)
+	{
+		m_best_mode = {};
+		m_last_index = -1;
+		log_error("Switchres: could not find a video mode that meets your specs\n");
+		return nullptr;
+	}
+
+	// If we need to create a new mode, our dummy entry goes to the end of the list
+	bool added = best_index == (int)video_modes.size();
+	if (added)
+	{
+		video_modes.push_back(best_mode);
+		journal_add(best_index);
+	}
+
+	modeline *best = &video_modes[best_index];
+	m_best_mode = video_modes.handle(best_index);
+	m_geometry_base = base_mode;
+
+	// The entry as the backend has it, put back if the backend rejects the new timings
+	m_applied_entry = *best;
+	m_fallback_modes.clear();
+	m_fallbacks_built = false;
+	m_applied_rank = 0;
+
+	// Keep what we need to solve a refresh only change of this request
+	m_last_request = request;
+	m_last_search = search;
+	m_last_index = (budget == nullptr || budget->complete)? best_index : -1;
+	m_last_range = base_mode.range;
+	m_last_weight = base_mode.result.weight;
+	m_last_v_diff = fabs(base_mode.result.v_diff);
+
+	log_verbose("\nSwitchres: %s (%dx%d@%.6f)->(%dx%d@%.6f)\n", rotation()?"rotated":"normal",
+		width, height, refresh, best_mode.hactive, best_mode.vactive, best_mode.vfreq);
+
+	if (log_verbose_enabled())
+		log_verbose("%s\n", modeline_result(&best_mode, result));
+
+	if (m_ds.modeline_generation && log_info_enabled())
+	{
+		char modeline[256]={'\x00'};
+		log_info("Switchres: Modeline %s\n", modeline_print(&best_mode, modeline, MS_FULL));
+	}
+
+	// Check if new best mode is different than previous one
+	m_switching_required = (current_mode() != best || best_mode.type & MODE_UPDATE);
+
+	if (modeline_is_different(best, &best_mode))
+		journal_update(best_index);
+
+	*best = best_mode;
+	reindex_mode(best_index);
+
+	// Entries may move in the list only with a new generation, the winner is
+	// still at m_last_index while this one holds
+	m_last_generation = m_table_generation;
+
+	// The changes above gave the list a new generation. If a new search would
+	// still pick the same entry, the result goes in for that one too, so asking
+	// for this mode again finds it. A reused entry is picked through the new
+	// mode again, which doesn't depend on the list
+	if (budget == nullptr || budget->complete)
+	{
+		uint64_t new_key = mode_cache_key(request, search);
+		if (new_key != cache_key && m_mode_cache.size() < MODE_CACHE_SIZE && (reused || entry_gives_mode(request, best_index, &base_mode, added)))
+			m_mode_cache[new_key] = { request, best_index, best_mode, base_mode, m_ds.gs };
+	}
+
+	if (!m_mode_pool.empty())
+		touch_mode(best_index);
+
+	return best;
+}
+
+//============================================================
+//  display_manager::get_modes
+//============================================================
+
+int display_manager::get_modes(const std::vector<mode_request> &requests, std::vector<modeline> &results)
+{
+	// Each result is the mode get_mode would return for that request, but
+	// it is not added to the mode list. Results with R_OUT_OF_RANGE weight
+	// mean no mode was found.
+	std::vector<mode_cache_entry> entries;
+	int modes_found = 0;
+
+	solve_modes(requests, entries);
+	results.resize(entries.size());
+
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		results[i] = entries[i].best_mode;
+		if (entries[i].best_index >= 0)
+			modes_found++;
+	}
+
+	return modes_found;
+}
+
+//============================================================
+//  display_manager::build_mode_cache
+//============================================================
+
+int display_manager::build_mode_cache(const std::vector<mode_request> &requests)
+{
+	// Solve the requests against the current mode list and store them in
+	// our persistent mode cache, returns the number of new records
+	std::vector<mode_cache_entry> entries;
+	int new_records = 0;
+
+	if (!m_mode_cache_file.is_open())
+	{
+		log_error("Switchres: no mode cache file defined\n");
+		return 0;
+	}
+
+	// Results that avoided timings rejected in this session don't belong in the file
+	if (!m_rejected_timings.empty())
+	{
+		log_info("Switchres: %d timings rejected in this session, not storing modes in %s\n", rejected_timings(), m_ds.mode_cache);
+		return 0;
+	}
+
+	solve_modes(requests, entries);
+
+	uint64_t search = search_hash();
+	for (auto &entry : entries)
+	{
+		uint64_t file_key = mode_file_key(entry.request, search);
+		if (m_mode_cache_file.find(file_key, entry.request) == nullptr && m_mode_cache_file.append(file_key, &entry))
+			new_records++;
+	}
+
+	log_info("Switchres: %d new modes stored in %s\n", new_records, m_ds.mode_cache);
+	return new_records;
+}
+
+//============================================================
+//  display_manager::prewarm_modes
+//============================================================
+
+int display_manager::prewarm_modes(const std::vector<mode_request> &requests)
+{
+	// Add the new modes these requests need to the driver in one batch, so
+	// switching to them later is just setting them. They go in as get_mode
+	// would add them, and get_mode picks them again for the same requests
+	// through reuse_mode. With mode_pool set, the least recently used modes
+	// we added make room for them. Returns the number of modes added
+	std::vector<mode_cache_entry> entries;
+	std::unordered_set<uint64_t> timings;
+	size_t limit = m_ds.mode_pool > 0? m_ds.mode_pool : requests.size();
+	int table_size = video_modes.size();
+	int added = 0;
+
+	if (video() == nullptr || !(caps() & CUSTOM_VIDEO_CAPS_ADD))
+	{
+		log_error("Switchres: the video backend can't add modes\n");
+		return 0;
+	}
+
+	solve_modes(requests, entries);
+
+	// Modes already in the list are left as they are
+	for (auto &entry : entries)
+	{
+		if (entry.best_index != table_size || (size_t)added >= limit || !timings.insert(timing_key(&entry.best_mode, false)).second)
+			continue;
+
+		modeline mode = entry.best_mode;
+		mode.type |= MODE_ADD;
+
+		video_modes.push_back(mode);
+		journal_add(video_modes.size() - 1);
+		added++;
+	}
+
+	if (added > 0)
+		flush_modes();
+
+	log_verbose("Switchres: prewarmed %d modes for %d requests\n", added, (int)requests.size());
+	return added;
+}
+
+//============================================================
+//  display_manager::solve_modes
+//============================================================
+
+void display_manager::solve_modes(const std::vector<mode_request> &requests, std::vector<mode_cache_entry> &entries)
+{
+	// Requests are solved in parallel on the shared work pool against the
+	// current mode table and monitor ranges, which are left untouched
+	int mode_caps = caps();
+	sync_mode_index();
+	std::atomic<int> modes_found(0);
+	work_pool *pool = work_pool::shared();
+
+	entries.assign(requests.size(), mode_cache_entry {});
+
+	pool->run(requests.size(), [&](int i, int)
+	{
+		mode_cache_entry *entry = &entries[i];
+
+		// Setting adjustments must not leak between requests
+		entry->request = requests[i];
+		entry->gs = m_ds.gs;
+
+		entry->best_index = find_best_mode(requests[i], &entry->best_mode, &entry->gs, mode_caps, false);
+		if (entry->best_index < 0)
+		{
+			entry->best_mode = {};
+			entry->best_mode.result.weight = R_OUT_OF_RANGE;
+			return;
+		}
+
+		finish_mode(&entry->best_mode, entry->best_index < (int)video_modes.size()? &video_modes[entry->best_index] : nullptr, &entry->gs, &entry->base_mode);
+		entry->best_index = reuse_mode(entry->best_index, &entry->best_mode);
+		modes_found++;
+	});
+
+	log_verbose("Switchres: solved %d of %d mode requests using %d threads\n", int(modes_found), (int)requests.size(), pool->workers());
+}
+
+//============================================================
+//  candidate_is_better
+//============================================================
+
+static bool candidate_is_better(const mode_candidate &a, const mode_candidate &b)
+{
+	// Equal scores keep the search order, like the single best search does
+	if (mode_score_less(&a.score, &b.score))
+		return true;
+
+	if (mode_score_less(&b.score, &a.score))
+		return false;
+
+	return a.order < b.order;
+}
+
+//============================================================
+//  add_candidate
+//============================================================
+
+static void add_candidate(std::vector<mode_candidate> &top, size_t top_k, const mode_candidate &candidate)
+{
+	// Bounded heap with the worst kept candidate on front
+	if (top.size() < top_k)
+	{
+		top.push_back(candidate);
+		std::push_heap(top.begin(), top.end(), candidate_is_better);
+	}
+	else if (top_k && candidate_is_better(candidate, top.front()))
+	{
+		std::pop_heap(top.begin(), top.end(), candidate_is_better);
+		top.back() = candidate;
+		std::push_heap(top.begin(), top.end(), candidate_is_better);
+	}
+}
+
+//============================================================
+//  display_manager::get_top_modes
+//============================================================
+
+int display_manager::get_top_modes(const mode_request &request, int k, std::vector<modeline> &modes)
+{
+	// The k best suitable modes for this request, best first. They are finished
+	// like get_modes results (geometry applied, flagged for add or update) but
+	// the mode list is left untouched.
+	std::vector<mode_candidate> top;
+	modeline best_mode = {};
+
+	modes.clear();
+	if (k <= 0)
+		return 0;
+
+	top.reserve(k);
+	sync_mode_index();
+	find_best_mode(request, &best_mode, &m_ds.gs, caps(), false, &top, k);
+	std::sort_heap(top.begin(), top.end(), candidate_is_better);
+
+	for (auto &candidate : top)
+	{
+		generator_settings gs = m_ds.gs;
+		finish_mode(&candidate.mode, candidate.index < (int)video_modes.size()? &video_modes[candidate.index] : nullptr, &gs);
+		modes.push_back(candidate.mode);
+	}
+
+	log_verbose("Switchres: found %d candidate modes for %dx%d@%.6f%s\n", (int)modes.size(), request.width, request.height, request.refresh, request.interlace?"i":"");
+	return modes.size();
+}
+
+//============================================================
+//  display_manager::apply_best_mode
+//============================================================
+
+bool display_manager::apply_best_mode()
+{
+	// Send the best mode to the backend if it's new or its timings changed. If the
+	// backend rejects it, its timings aren't offered again this session and the
+	// next ranked candidate of the request is tried, applied_rank tells which one
+	// made it (0 is the best mode, -1 none)
+	if (best_mode() == nullptr)
+		return false;
+
+	for (;;)
+	{
+		modeline *best = best_mode();
+		if (!(best->type & (MODE_ADD | MODE_UPDATE)))
+			return true;
+
+		bool adding = best->type & MODE_ADD;
+		if (adding? add_mode(best) : update_mode(best))
+		{
+			// A new mode may push an older one of ours out of the pool
+			if (adding)
+			{
+				pool_mode(video_modes.index(m_best_mode));
+				if (m_ds.mode_pool > 0 && (int)m_mode_pool.size() > m_ds.mode_pool && evict_modes(m_mode_pool.size() - m_ds.mode_pool))
+					flush_modes();
+			}
+
+			m_applied_entry = *best;
+			if (m_applied_rank > 0)
+				log_info("Switchres: using candidate %d for %dx%d@%.6f\n", m_applied_rank, m_last_request.width, m_last_request.height, m_last_request.refresh);
+			return true;
+		}
+
+		reject_best_mode();
+		if (!next_fallback_mode())
+			break;
+	}
+
+	m_applied_rank = -1;
+	log_error("Switchres: no candidate mode was accepted by the video backend\n");
+	return false;
+}
+
+//============================================================
+//  display_manager::reject_best_mode
+//============================================================
+
+void display_manager::reject_best_mode()
+{
+	// Timings are marked as sent and, for editable modes, as solved, which is
+	// how the search sees them. A mode that isn't in the driver yet leaves the
+	// list, any other entry is put back as the backend has it
+	modeline *best = best_mode();
+	int index = video_modes.index(m_best_mode);
+
+	m_rejected_timings.insert(timing_key(best, false));
+	if (m_geometry_base.type & V_FREQ_EDITABLE)
+		m_rejected_timings.insert(timing_key(&m_geometry_base, true));
+	log_verbose("Switchres: timings of candidate %d rejected by the video backend\n", m_applied_rank);
+
+	if (best->type & MODE_ADD)
+	{
+		bool last = index == (int)video_modes.size() - 1;
+		journal_delete(index);
+		erase_mode(index);
+
+		// New mode candidates still point past the end of the list. If the entry was
+		// in the middle, its candidates are gone and the ones after it move down
+		if (!last)
+		{
+			for (auto &candidate : m_fallback_modes)
+				if (candidate.index == index)
+					candidate.index = INT_MAX;
+				else if (candidate.index > index)
+					candidate.index--;
+		}
+	}
+	else
+	{
+		*best = m_applied_entry;
+		table_changed(index);
+		reindex_mode(index);
+	}
+
+	m_best_mode = {};
+	m_last_index = -1;
+}
+
+//============================================================
+//  display_manager::next_fallback_mode
+//============================================================
+
+bool display_manager::next_fallback_mode()
+{
+	// The ranked candidates are only searched for on the first rejection, the
+	// rejected timings are already left out
+	if (!m_fallbacks_built)
+	{
+		modeline best_mode = {};
+		sync_mode_index();
+		find_best_mode(m_last_request, &best_mode, &m_ds.gs, caps(), false, &m_fallback_modes, MODE_FALLBACKS);
+		std::sort_heap(m_fallback_modes.begin(), m_fallback_modes.end(), candidate_is_better);
+		m_fallbacks_built = true;
+	}
+
+	while (m_applied_rank < (int)m_fallback_modes.size())
+	{
+		const mode_candidate &candidate = m_fallback_modes[m_applied_rank++];
+		if (is_rejected(&candidate.mode, true) || candidate.index > (int)video_modes.size())
+			continue;
+
+		modeline mode = candidate.mode;
+		modeline base_mode = {};
+		finish_mode(&mode, candidate.index < (int)video_modes.size()? &video_modes[candidate.index] : nullptr, &m_ds.gs, &base_mode);
+		if (is_rejected(&mode, false))
+			continue;
+
+		if (candidate.index == (int)video_modes.size())
+		{
+			video_modes.push_back(mode);
+			journal_add(candidate.index);
+		}
+		else if (modeline_is_different(&video_modes[candidate.index], &mode))
+			journal_update(candidate.index);
+
+		modeline *best = &video_modes[candidate.index];
+		m_best_mode = video_modes.handle(candidate.index);
+		m_applied_entry = *best;
+		*best = mode;
+		reindex_mode(candidate.index);
+		m_geometry_base = base_mode;
+		m_switching_required = (current_mode() != best || mode.type & MODE_UPDATE);
+
+		char modeline[256]={'\x00'};
+		log_verbose("Switchres: trying candidate %d %s\n", m_applied_rank, modeline_print(&mode, modeline, MS_FULL));
+		return true;
+	}
+
+	return false;
+}
+
+//============================================================
+//  display_manager::find_best_mode
+//============================================================
+
+int display_manager::find_best_mode(const mode_request &request, modeline *best_mode, const generator_settings *gs, int caps, bool trace, std::vector<mode_candidate> *top, size_t top_k, mode_budget *budget)
+{
+	// Our mode list is only read here, so this can be called from several
+	// threads at once. Returns the index of the best mode, video_modes.size()
+	// if it's the dummy entry, or -1 if there's no suitable mode. If top is
+	// passed, the top_k best suitable candidates are kept there as a heap.
+	// If budget is passed, modes are tried in search_order until its deadline
+	// and ties go to the lowest index, so a complete search gives the same
+	// result as the plain one. Only unlocked modes are visited, unless tracing.
+	modeline s_mode = {};
+	modeline t_mode = {};
+	modeline dummy_mode = {};
+	int best_index = -1;
+	int table_size = video_modes.size();
+	int num_entries = trace? table_size : m_unlocked_modes.size();
+	int num_modes = num_entries;
+
+	*best_mode = {};
+	best_mode->result.weight |= R_OUT_OF_RANGE;
+
+	bool best_vector = false;
+	mode_score best_score = modeline_score(best_mode, best_vector);
+	int order = 0;
+
+	source_mode(request, gs, &s_mode);
+
+	// Create a dummy mode entry if allowed
+	if (caps & CUSTOM_VIDEO_CAPS_ADD && m_ds.modeline_generation)
+	{
+		dummy_mode.type = XYV_EDITABLE | V_FREQ_EDITABLE | SCAN_EDITABLE | MODE_ADD | (desktop_is_rotated()? MODE_ROTATED : MODE_OK);
+		num_modes++;
+	}
+
+	std::vector<int> mode_order;
+	if (budget)
+		search_order(&s_mode, num_modes, trace, mode_order);
+
+	// Run through our mode list and find the most suitable mode
+	int generated = 0;
+	for (int n = 0; n < num_modes && !(budget && !budget->complete); n++)
+	{
+		int m = budget? mode_order[n] : n == num_entries? table_size : trace? n : m_unlocked_modes[n];
+
+		modeline &mode = m < table_size? video_modes[m] : dummy_mode;
+
+		if (trace)
+			trace_add(TRACE_MODE, m, 0, &mode);
+
+		// now get the mode if allowed
+		if (mode.type & MODE_DISABLED)
+			continue;
+
+		modeline base_mode = template_mode(&mode, &s_mode);
+
+		// Cheap early checks of this mode on all our ranges at once
+		int weight_bounds[RANGE_SET_SIZE];
+		modeline_weight_bounds(&s_mode, &base_mode, range, &m_range_set, gs, weight_bounds);
+
+		for (int k = 0; k < m_range_set.count; k++)
+		{
+			int i = m_range_set.index[k];
+			t_mode = base_mode;
+
+			// Skip the full generation if this mode can't beat our current best, an out of
+			// range mode never can (only its weight counts when no mode is suitable)
+			int weight_limit = best_mode->result.weight;
+			if (top)
+				weight_limit = top->size() < top_k? R_OUT_OF_RANGE : top->front().mode.result.weight;
+
+			if ((weight_bounds[k] & R_OUT_OF_RANGE) || weight_bounds[k] > weight_limit)
+			{
+				if (trace)
+					trace_add(TRACE_SKIPPED, m, i, &t_mode);
+
+				m_pruned_candidates++;
+				continue;
+			}
+
+			// The first candidate is always generated, so there's a result if it is suitable
+			if (budget && generated++ > 0 && std::chrono::steady_clock::now() >= budget->deadline)
+			{
+				budget->complete = false;
+				log_verbose("Switchres: deadline reached after %d candidates\n", generated - 1);
+				break;
+			}
+
+			t_mode = modeline_generate(&s_mode, &t_mode, &range[i], gs);
+			t_mode.range = i;
+
+			if (trace)
+				trace_add(TRACE_RANGE, m, i, &t_mode);
+
+			if (is_rejected(&t_mode, true))
+				continue;
+
+			// Rank both modes with the criteria that apply to the new one, as modeline_compare does
+			bool vector = modeline_is_vector(&t_mode);
+			mode_score score = modeline_score(&t_mode, vector);
+			if (vector != best_vector)
+			{
+				best_score = modeline_score(best_mode, vector);
+				best_vector = vector;
+			}
+
+			if (mode_score_less(&score, &best_score) || (best_index > m && !mode_score_less(&best_score, &score)))
+			{
+				*best_mode = t_mode;
+				best_index = m;
+				best_score = score;
+			}
+
+			if (top && !(t_mode.result.weight & R_OUT_OF_RANGE))
+				add_candidate(*top, top_k, { score, order++, m, t_mode });
+		}
+	}
+
+	return (best_mode->result.weight & R_OUT_OF_RANGE)? -1 : best_index;
+}
+
+//============================================================
+//  display_manager::find_best_mode_parallel
+//============================================================
+
+int display_manager::find_best_mode_parallel(const mode_request &request, modeline *best_mode, const generator_settings *gs, int caps)
+{
+	// Same result as find_best_mode, with the mode list split in chunks on the
+	// shared work pool. Weight comes first in the candidate ordering, so only the
+	// candidates with the lowest weight can win. Each worker keeps the ones with
+	// its lowest weight, then those with the overall lowest are ranked in list
+	// order, as the single threaded search does. Small searches and traced ones
+	// stay on this thread.
+	bool add_dummy = caps & CUSTOM_VIDEO_CAPS_ADD && m_ds.modeline_generation;
+	int table_size = video_modes.size();
+	int num_entries = m_unlocked_modes.size();
+	int num_modes = num_entries + (add_dummy? 1 : 0);
+	work_pool *pool = work_pool::shared();
+
+	if (m_trace_enabled || pool->workers() < 2 || num_modes * m_range_set.count < PARALLEL_MIN_CANDIDATES)
+		return find_best_mode(request, best_mode, gs, caps, m_trace_enabled);
+
+	modeline s_mode = {};
+	modeline dummy_mode = {};
+	source_mode(request, gs, &s_mode);
+
+	if (add_dummy)
+		dummy_mode.type = XYV_EDITABLE | V_FREQ_EDITABLE | SCAN_EDITABLE | MODE_ADD | (desktop_is_rotated()? MODE_ROTATED : MODE_OK);
+
+	typedef struct alignas(64) worker_best
+	{
+		int weight;
+		std::vector<mode_candidate> modes;
+	} worker_best;
+
+	std::vector<worker_best> local(pool->workers());
+	std::atomic<int> best_weight(R_OUT_OF_RANGE);
+	int chunk = std::max(1, num_modes / (pool->workers() * 4));
+
+	for (auto &best : local)
+		best.weight = R_OUT_OF_RANGE;
+
+	pool->run((num_modes + chunk - 1) / chunk, [&](int task, int worker)
+	{
+		worker_best &best = local[worker];
+
+		for (int n = task * chunk; n < std::min(num_modes, (task + 1) * chunk); n++)
+		{
+			int m = n < num_entries? m_unlocked_modes[n] : table_size;
+			const modeline &mode = m < table_size? video_modes[m] : dummy_mode;
+			if (mode.type & MODE_DISABLED)
+				continue;
+
+			modeline base_mode = template_mode(&mode, &s_mode);
+
+			int weight_bounds[RANGE_SET_SIZE];
+			modeline_weight_bounds(&s_mode, &base_mode, range, &m_range_set, gs, weight_bounds);
+
+			for (int k = 0; k < m_range_set.count; k++)
+			{
+				int i = m_range_set.index[k];
+
+				// Any worker's best weight is a valid limit, ties are kept
+				if ((weight_bounds[k] & R_OUT_OF_RANGE) || weight_bounds[k] > best_weight.load(std::memory_order_relaxed))
+				{
+					m_pruned_candidates++;
+					continue;
+				}
+
+				modeline t_mode = modeline_generate(&s_mode, &base_mode, &range[i], gs);
+				t_mode.range = i;
+
+				int weight = t_mode.result.weight;
+				if (weight & R_OUT_OF_RANGE || weight > best.weight || is_rejected(&t_mode, true))
+					continue;
+
+				if (weight < best.weight)
+				{
+					best.weight = weight;
+					best.modes.clear();
+				}
+				best.modes.push_back({ {}, m * RANGE_SET_SIZE + k, m, t_mode });
+
+				int limit = best_weight.load(std::memory_order_relaxed);
+				while (weight < limit && !best_weight.compare_exchange_weak(limit, weight, std::memory_order_relaxed));
+			}
+		}
+	});
+
+	// Rank the lowest weight candidates in list order, like find_best_mode
+	std::vector<mode_candidate> winners;
+	for (auto &best : local)
+		if (best.weight == best_weight)
+			winners.insert(winners.end(), best.modes.begin(), best.modes.end());
+
+	std::sort(winners.begin(), winners.end(), [](const mode_candidate &a, const mode_candidate &b) { return a.order < b.order; });
+
+	*best_mode = {};
+	best_mode->result.weight |= R_OUT_OF_RANGE;
+	if (winners.empty())
+		return -1;
+
+	int best_index = winners[0].index;
+	*best_mode = winners[0].mode;
+
+	for (size_t n = 1; n < winners.size(); n++)
+	{
+		bool vector = modeline_is_vector(&winners[n].mode);
+		mode_score score = modeline_score(&winners[n].mode, vector);
+		mode_score best_score = modeline_score(best_mode, vector);
+
+		if (mode_score_less(&score, &best_score))
+		{
+			*best_mode = winners[n].mode;
+			best_index = winners[n].index;
+		}
+	}
+
+	return best_index;
+}
+
+//============================================================
+//  display_manager::search_order
+//============================================================
+
+void display_manager::search_order(const modeline *s_mode, int num_modes, bool locked, std::vector<int> &order)
+{
+	// Likely winners first: the current mode, modes with the source resolution,
+	// the dummy entry and then the rest of the unlocked modes. Locked modes go
+	// last if they're listed
+	int table_size = video_modes.size();
+	bool dummy = num_modes > (locked? table_size : (int)m_unlocked_modes.size());
+	uint64_t key = resolution_key(s_mode->hactive, s_mode->vactive);
+	int current = video_modes.index(m_current_mode);
+
+	if (current >= 0 && (video_modes[current].type & MODE_DISABLED))
+		current = -1;
+
+	order.reserve(num_modes);
+	if (current >= 0)
+		order.push_back(current);
+
+	auto same = m_mode_index.find(key);
+	if (same != m_mode_index.end())
+		for (int m : same->second)
+			if (m != current && !(video_modes[m].type & MODE_DISABLED))
+				order.push_back(m);
+
+	if (dummy)
+		order.push_back(table_size);
+
+	for (int m : m_unlocked_modes)
+		if (m != current && m_mode_keys[m] != key)
+			order.push_back(m);
+
+	if (locked)
+		for (int m = 0; m < table_size; m++)
+			if (video_modes[m].type & MODE_DISABLED)
+				order.push_back(m);
+}
+
+//============================================================
+//  display_manager::refresh_only_mode
+//============================================================
+
+int display_manager::refresh_only_mode(const mode_request &request, uint64_t search, modeline *best_mode)
+{
+	// If this request only differs from the last solved one in refresh, solve
+	// it again on the previous winner and range alone. Returns -1 when that
+	// doesn't apply or the result is worse than last time (weight or refresh
+	// difference), so the full search must run instead
+	if (m_last_index < 0 || m_trace_enabled || search != m_last_search || m_table_generation != m_last_generation
+		|| m_last_index >= (int)video_modes.size() || request.width != m_last_request.width || request.height != m_last_request.height
+		|| request.interlace != m_last_request.interlace || request.refresh == m_last_request.refresh)
+		return -1;
+
+	const modeline *mode = &video_modes[m_last_index];
+	if (mode->type & MODE_DISABLED)
+		return -1;
+
+	modeline s_mode = {};
+	source_mode(request, &m_ds.gs, &s_mode);
+
+	modeline t_mode = template_mode(mode, &s_mode);
+	t_mode = modeline_generate(&s_mode, &t_mode, &range[m_last_range], &m_ds.gs);
+	t_mode.range = m_last_range;
+
+	if ((t_mode.result.weight & R_OUT_OF_RANGE) || t_mode.result.weight > m_last_weight || fabs(t_mode.result.v_diff) > m_last_v_diff || is_rejected(&t_mode, true))
+		return -1;
+
+	m_refresh_fast_path++;
+	log_verbose("Switchres: refresh only change, solved on mode %d range %d\n", m_last_index, m_last_range);
+
+	*best_mode = t_mode;
+	return m_last_index;
+}
+
+//============================================================
+//  display_manager::entry_gives_mode
+//============================================================
+
+bool display_manager::entry_gives_mode(const mode_request &request, int index, const modeline *base_mode, bool added)
+{
+	// True if entry index, as it is now, is solved into base_mode again for
+	// this request. It's the only entry that changed since base_mode won, so
+	// then a new search picks it again. Its ranges are ranked as find_best_mode
+	// does, the first of equal ones wins. An entry just added from the new mode
+	// is also picked through that new mode, through reuse_mode, as long as it
+	// doesn't do better itself
+	const modeline *entry = &video_modes[index];
+	if (entry->type & MODE_DISABLED)
+		return false;
+
+	modeline s_mode = {};
+	source_mode(request, &m_ds.gs, &s_mode);
+	modeline t_base = template_mode(entry, &s_mode);
+
+	modeline best = {};
+	best.result.weight |= R_OUT_OF_RANGE;
+	bool best_vector = false;
+	mode_score best_score = modeline_score(&best, best_vector);
+
+	for (int k = 0; k < m_range_set.count; k++)
+	{
+		int i = m_range_set.index[k];
+		modeline t_mode = modeline_generate(&s_mode, &t_base, &range[i], &m_ds.gs);
+		t_mode.range = i;
+
+		if (is_rejected(&t_mode, true))
+			continue;
+
+		bool vector = modeline_is_vector(&t_mode);
+		mode_score score = modeline_score(&t_mode, vector);
+		if (vector != best_vector)
+		{
+			best_score = modeline_score(&best, vector);
+			best_vector = vector;
+		}
+
+		if (mode_score_less(&score, &best_score))
+		{
+			best = t_mode;
+			best_score = score;
+		}
+	}
+
+	mode_score base_score = modeline_score(base_mode, best_vector);
+	if (added && ((best.result.weight & R_OUT_OF_RANGE) || mode_score_less(&base_score, &best_score)))
+		return true;
+
+	return !(best.result.weight & R_OUT_OF_RANGE) && best.range == base_mode->range && !modeline_is_different(&best, base_mode)
+		&& !mode_score_less(&best_score, &base_score) && !mode_score_less(&base_score, &best_score);
+}
+
+//============================================================
+//  display_manager::source_mode
+//============================================================
+
+void display_manager::source_mode(const mode_request &request, const generator_settings *gs, modeline *s_mode)
+{
+	s_mode->interlace = request.interlace;
+	s_mode->vfreq = request.refresh;
+
+	s_mode->hactive = normalize(request.width, 8);
+	s_mode->vactive = request.height;
+
+	if (gs->rotation) std::swap(s_mode->hactive, s_mode->vactive);
+}
+
+//============================================================
+//  display_manager::template_mode
+//============================================================
+
+modeline display_manager::template_mode(const modeline *mode, const modeline *s_mode)
+{
+	modeline base_mode = *mode;
+
+	// init all editable fields with source or user values
+	if (base_mode.type & X_RES_EDITABLE)
+		base_mode.hactive = m_user_mode.width? m_user_mode.width : s_mode->hactive;
+
+	if (base_mode.type & Y_RES_EDITABLE)
+		base_mode.vactive = m_user_mode.height? m_user_mode.height : s_mode->vactive;
+
+	if (base_mode.type & V_FREQ_EDITABLE)
+	{
+		// If user's vfreq is defined, it means we have an user modeline, so force it
+		if (m_user_mode.vfreq)
+		{
+			int t_type = base_mode.type;
+			base_mode = m_user_mode;
+			base_mode.type = t_type;
+		}
+		else
+			base_mode.vfreq = s_mode->vfreq;
+	}
+
+	// lock resolution fields if required
+	if (m_user_mode.width) base_mode.type &= ~X_RES_EDITABLE;
+	if (m_user_mode.height) base_mode.type &= ~Y_RES_EDITABLE;
+	if (m_user_mode.vfreq) base_mode.type &= ~V_FREQ_EDITABLE;
+
+	return base_mode;
+}
+
+//============================================================
+//  display_manager::set_mode_trace
+//============================================================
+
+void display_manager::set_mode_trace(bool value)
+{
+	m_trace_enabled = value;
+	m_trace_count = 0;
+
+	if (value)
+		m_trace.resize(MODE_TRACE_SIZE);
+	else
+		std::vector<mode_trace_record>().swap(m_trace);
+}
+
+//============================================================
+//  display_manager::trace_add
+//============================================================
+
+void display_manager::trace_add(int kind, int mode_index, int range, const modeline *mode)
+{
+	// Oldest records are overwritten once the buffer is full
+	mode_trace_record &record = m_trace[m_trace_count++ % m_trace.size()];
+
+	record.kind = kind;
+	record.mode_index = mode_index;
+	record.range = range;
+	record.type = mode->type;
+	record.interlace = mode->interlace;
+	record.doublescan = mode->doublescan;
+	record.vfreq = mode->vfreq;
+	record.hfreq = mode->hfreq;
+	record.result = mode->result;
+
+	// Mode headers show the listed size, range results the generated one
+	record.width = kind == TRACE_MODE? mode->width : mode->hactive;
+	record.height = kind == TRACE_MODE? mode->height : mode->vactive;
+	record.refresh = mode->refresh;
+}
+
+//============================================================
+//  display_manager::print_mode_trace
+//============================================================
+
+void display_manager::print_mode_trace()
+{
+	char result[256]={'\x00'};
+	size_t first = m_trace_count > m_trace.size()? m_trace_count - m_trace.size() : 0;
+
+	if (first)
+		log_verbose("\nSwitchres: %d older trace records dropped\n", (int)first);
+
+	for (size_t i = first; i < m_trace_count; i++)
+	{
+		const mode_trace_record &record = m_trace[i % m_trace.size()];
+
+		if (record.kind == TRACE_MODE)
+			log_verbose("\nSwitchres: %s%4d%sx%s%4d%s_%s%d=%.6fHz%s%s\n",
+				record.type & X_RES_EDITABLE?"(":"[", record.width, record.type & X_RES_EDITABLE?")":"]",
+				record.type & Y_RES_EDITABLE?"(":"[", record.height, record.type & Y_RES_EDITABLE?")":"]",
+				record.type & V_FREQ_EDITABLE?"(":"[", record.refresh, record.vfreq, record.type & V_FREQ_EDITABLE?")":"]",
+				record.type & MODE_DISABLED?" - locked":"");
+
+		else if (record.kind == TRACE_SKIPPED)
+			log_verbose("   rng(%d):  skipped, can't beat current best\n", record.range);
+
+		else
+		{
+			modeline mode = {};
+			mode.range = record.range;
+			mode.hactive = record.width;
+			mode.vactive = record.height;
+			mode.interlace = record.interlace;
+			mode.doublescan = record.doublescan;
+			mode.vfreq = record.vfreq;
+			mode.hfreq = record.hfreq;
+			mode.result = record.result;
+			log_verbose("%s\n", modeline_result(&mode, result));
+		}
+	}
+}
+
+//============================================================
+//  display_manager::finish_mode
+//============================================================
+
+void display_manager::finish_mode(modeline *best_mode, const modeline *target, generator_settings *gs, modeline *base_mode)
+{
+	// Apply geometry adjustments to the winning mode and flag how it must be
+	// copied to the mode entry it comes from (target). The mode as solved is
+	// kept in base_mode, for adjust_geometry
+	if (base_mode)
+		*base_mode = *best_mode;
+
+	if (best_mode->type & V_FREQ_EDITABLE)
+	{
+		double refresh = best_mode->vfreq / (1.0 + best_mode->result.v_ppm / 1e6);
+		*best_mode = modeline_apply_geometry(best_mode, range[best_mode->range].hfreq_max, gs, gs);
+		finish_refresh(best_mode, refresh, gs);
+	}
+
+	if (!m_ds.modeline_generation)
+		return;
+
+	if (best_mode->type & MODE_ADD)
+	{
+		best_mode->width = best_mode->hactive;
+		best_mode->height = best_mode->vactive;
+		best_mode->refresh = int(best_mode->vfreq);
+		// lock new mode
+		best_mode->type &= ~(X_RES_EDITABLE | Y_RES_EDITABLE);
+	}
+	else if (modeline_is_different(best_mode, target) != 0)
+		best_mode->type |= MODE_UPDATE;
+}
+
+//============================================================
+//  display_manager::reuse_mode
+//============================================================
+
+int display_manager::reuse_mode(int index, modeline *best_mode)
+{
+	// A new mode, or new timings for an entry, that one of our entries already
+	// has is that entry. A fixed entry isn't solved into its own timings again
+	// (a doublescanned one, say), and an editable one earlier in the list wins
+	// ties, so the search comes up with those instead. Returns the index to
+	// use, best_mode takes the entry's flags and backend id
+	if (index != (int)video_modes.size() && !(best_mode->type & MODE_UPDATE))
+		return index;
+
+	auto same = m_mode_index.find(resolution_key(best_mode->width, best_mode->height));
+	if (same == m_mode_index.end())
+		return index;
+
+	uint64_t key = timing_key(best_mode, false);
+	for (int m : same->second)
+	{
+		const modeline *entry = &video_modes[m];
+		if (m == index || entry->type & MODE_DISABLED || timing_key(entry, false) != key)
+			continue;
+
+		best_mode->type = entry->type;
+		best_mode->platform_data = entry->platform_data;
+		best_mode->refresh = entry->refresh;
+		return m;
+	}
+
+	return index;
+}
+
+//============================================================
+//  display_manager::finish_refresh
+//============================================================
+
+void display_manager::finish_refresh(modeline *mode, double target, const generator_settings *gs)
+{
+	// Measure the refresh error against the refresh the mode was solved for, as
+	// geometry adjustments may have regenerated it from itself, then refine it
+	// if an exact refresh was asked for
+	mode->result.v_ppm = (mode->vfreq / target - 1.0) * 1e6;
+
+	if (gs->refresh_ppm > 0)
+		modeline_refine_refresh(mode, &range[mode->range], gs, target);
+}
+
+//============================================================
+//  hash helpers
+//============================================================
+
+static inline uint64_t hash_add(uint64_t hash, uint64_t value)
+{
+	// FNV-1a step over a whole word, folding the high bits back in
+	hash = (hash ^ value) * 0x100000001b3;
+	return hash ^ (hash >> 32);
+}
+
+static inline uint64_t hash_add(uint64_t hash, double value)
+{
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return hash_add(hash, bits);
+}
+
+static uint64_t hash_modeline(uint64_t hash, const modeline *mode)
+{
+	// Only what carries over to other sessions: the backend's id for the mode
+	// and the flags of changes still pending stay out
+	const int fields[] = { mode->hactive, mode->hbegin, mode->hend, mode->htotal, mode->vactive, mode->vbegin, mode->vend, mode->vtotal,
+		mode->interlace, mode->doublescan, mode->hsync, mode->vsync, mode->width, mode->height, mode->refresh, mode->refresh_label,
+		int(mode->type & ~(MODE_ADD | MODE_UPDATE | MODE_DELETE | MODE_ERROR)), mode->range };
+
+	hash = hash_add(hash, mode->pclock);
+	for (int field : fields)
+		hash = hash_add(hash, uint64_t(field));
+
+	hash = hash_add(hash, mode->vfreq);
+	return hash_add(hash, mode->hfreq);
+}
+
+//============================================================
+//  display_manager::settings_hash
+//============================================================
+
+uint64_t display_manager::settings_hash()
+{
+	// Hash of the generator settings and monitor ranges
+	uint64_t hash = 0xcbf29ce484222325;
+	generator_settings *gs = &m_ds.gs;
+
+	const int gs_fields[] = { gs->interlace, gs->doublescan, gs->rotation, gs->super_width, gs->h_shift, gs->v_shift,
+		gs->v_shift_correct, gs->pixel_precision, gs->interlace_force_even, gs->timing_engine };
+
+	for (int field : gs_fields)
+		hash = hash_add(hash, uint64_t(field));
+
+	hash = hash_add(hash, gs->pclock_min);
+	hash = hash_add(hash, gs->monitor_aspect);
+	hash = hash_add(hash, gs->refresh_tolerance);
+	hash = hash_add(hash, gs->h_size);
+	hash = hash_add(hash, gs->refresh_ppm);
+
+	const timing_constraints *tc = &gs->constraints;
+	const int tc_fields[] = { tc->htotal_align, tc->htotal_max, tc->vtotal_max };
+
+	hash = hash_add(hash, tc->pclock_quantum);
+	hash = hash_add(hash, tc->pclock_min);
+	hash = hash_add(hash, tc->pclock_max);
+	for (int field : tc_fields)
+		hash = hash_add(hash, uint64_t(field));
+
+	for (int i = 0; i < MAX_RANGES; i++)
+	{
+		monitor_range *r = &range[i];
+		const double range_values[] = { r->hfreq_min, r->hfreq_max, r->vfreq_min, r->vfreq_max, r->hfront_porch, r->hsync_pulse, r->hback_porch,
+			r->vfront_porch, r->vsync_pulse, r->vback_porch, r->vertical_blank };
+		const int range_fields[] = { r->hsync_polarity, r->vsync_polarity, r->progressive_lines_min, r->progressive_lines_max,
+			r->interlaced_lines_min, r->interlaced_lines_max };
+
+		for (double value : range_values)
+			hash = hash_add(hash, value);
+
+		for (int field : range_fields)
+			hash = hash_add(hash, uint64_t(field));
+	}
+
+	return hash;
+}
+
+//============================================================
+//  display_manager::search_hash
+//============================================================
+
+uint64_t display_manager::search_hash()
+{
+	// Hash of every input of the mode search but the request and the mode list
+	uint64_t hash = settings_hash();
+
+	hash = hash_modeline(hash, &m_user_mode);
+	hash = hash_add(hash, uint64_t(m_ds.modeline_generation));
+	hash = hash_add(hash, uint64_t(m_desktop_is_rotated));
+	hash = hash_add(hash, uint64_t(m_rejected_timings.size()));
+	return hash_add(hash, uint64_t(caps()));
+}
+
+//============================================================
+//  display_manager::timing_key
+//============================================================
+
+uint64_t display_manager::timing_key(const modeline *mode, bool solved)
+{
+	// Hash of the timings alone. Solved timings of editable modes get their own
+	// keys, geometry adjustments change them before they reach the backend
+	const int fields[] = { mode->hactive, mode->hbegin, mode->hend, mode->htotal, mode->vactive, mode->vbegin, mode->vend, mode->vtotal,
+		mode->interlace, mode->doublescan };
+
+	uint64_t hash = hash_add(0xcbf29ce484222325, uint64_t(solved));
+	hash = hash_add(hash, mode->pclock);
+	for (int field : fields)
+		hash = hash_add(hash, uint64_t(field));
+
+	return hash;
+}
+
+//============================================================
+//  display_manager::is_rejected
+//============================================================
+
+bool display_manager::is_rejected(const modeline *mode, bool solved)
+{
+	if (m_rejected_timings.empty())
+		return false;
+
+	return m_rejected_timings.count(timing_key(mode, solved && mode->type & V_FREQ_EDITABLE));
+}
+
+//============================================================
+//  display_manager::mode_cache_key
+//============================================================
+
+uint64_t display_manager::mode_cache_key(const mode_request &request, uint64_t search)
+{
+	// Every input of the mode search goes into the key, so changing any
+	// of them through the setters naturally misses old entries. The mode
+	// list goes in by its generation. search must come from search_hash()
+	uint64_t hash = search;
+
+	hash = hash_add(hash, uint64_t(request.width));
+	hash = hash_add(hash, uint64_t(request.height));
+	hash = hash_add(hash, double(request.refresh));
+	hash = hash_add(hash, uint64_t(request.interlace));
+	hash = hash_add(hash, m_table_generation);
+
+	return hash_add(hash, uint64_t(video_modes.size()));
+}
+
+//============================================================
+//  display_manager::mode_file_key
+//============================================================
+
+uint64_t display_manager::mode_file_key(const mode_request &request, uint64_t search)
+{
+	// As mode_cache_key, with the mode list contents instead of its
+	// generation, which doesn't carry over to other sessions
+	uint64_t hash = search;
+
+	hash = hash_add(hash, uint64_t(request.width));
+	hash = hash_add(hash, uint64_t(request.height));
+	hash = hash_add(hash, double(request.refresh));
+	hash = hash_add(hash, uint64_t(request.interlace));
+
+	for (auto &mode : video_modes)
+		hash = hash_modeline(hash, &mode);
 
-	*m_best_mode = best_mode;
-	return m_best_mode;
+	return hash_add(hash, uint64_t(video_modes.size()));
 }
 
 //============================================================
@@ -497,6 +2263,7 @@ bool display_manager::auto_specs()
 	if (desktop_mode.type & CUSTOM_VIDEO_TIMING_SYSTEM) modeline_vesa_gtf(&desktop_mode);
 	modeline_to_monitor_range(range, &desktop_mode);
 	monitor_show_range(range);
+	update_ranges();
 
 	// Force our resolution to LCD's native one
 	modeline user_mode = {};
@@ -16,7 +16,13 @@
 #define __DISPLAY_H__
 
 #include <vector>
+#include <atomic>
+#include <chrono>
+#include <unordered_map>
+#include <unordered_set>
 #include "modeline.h"
+#include "mode_cache.h"
+#include "mode_table.h"
 #include "custom_video.h"
 
 typedef struct display_settings
@@ -28,16 +34,82 @@ typedef struct display_settings
 	bool   lock_system_modes;
 	bool   refresh_dont_care;
 	bool   keep_changes;
+	int    mode_pool;
 	char   monitor[32];
 	char   crt_range[MAX_RANGES][256];
 	char   lcd_range[256];
 	char   user_modeline[256];
+	char   mode_cache[256];
 	modeline user_mode;
 
 	generator_settings gs;
 	custom_video_settings vs;
 } display_settings;
 
+#define MODE_CACHE_SIZE 256
+#define MODE_TRACE_SIZE 1024
+
+// Mode journal records kept before the first compaction
+#define MODE_JOURNAL_SLACK 64
+
+// Ranked candidates kept to replace a mode the video backend rejects
+#define MODE_FALLBACKS 4
+
+// Smallest (mode x range) search split across the work pool, smaller ones run on the caller's thread
+#define PARALLEL_MIN_CANDIDATES 128
+
+// Trace record kinds
+#define TRACE_MODE     0
+#define TRACE_RANGE    1
+#define TRACE_SKIPPED  2
+
+typedef struct mode_trace_record
+{
+	int    kind;
+	int    mode_index;
+	int    range;
+	int    type;
+	int    width;
+	int    height;
+	int    refresh;
+	int    interlace;
+	int    doublescan;
+	double vfreq;
+	double hfreq;
+	mode_result result;
+} mode_trace_record;
+
+typedef struct mode_candidate
+{
+	mode_score score;
+	int order;
+	int index;
+	modeline mode;
+} mode_candidate;
+
+// Change Switchres made to the mode list: MODE_ADD or MODE_UPDATE of the
+// entry at handle, or MODE_DELETE of one. original is the entry before it
+typedef struct mode_change
+{
+	int type;
+	mode_handle handle;
+	modeline original;
+} mode_change;
+
+// Mode we added to the driver, by last use
+typedef struct pooled_mode
+{
+	mode_handle handle;
+	uint64_t last_used;
+} pooled_mode;
+
+// Time limit of a mode search. complete tells if all candidates were evaluated before it
+typedef struct mode_budget
+{
+	std::chrono::steady_clock::time_point deadline;
+	bool complete;
+} mode_budget;
+
 
 class display_manager
 {
@@ -52,8 +124,11 @@ public:
 
 	display_manager *make(display_settings *ds);
 	void parse_options();
+	void update_constraints();
+	void open_mode_cache();
 	virtual bool init(void* = nullptr);
 	virtual int caps();
+	timing_constraints constraints();
 
 	// getters
 	int index() const { return m_index; }
@@ -63,12 +138,13 @@ public:
 
 	// getters (modes)
 	modeline user_mode() const { return m_user_mode; }
-	modeline *best_mode() const { return m_best_mode; }
-	modeline *current_mode() const { return m_current_mode; }
+	modeline *best_mode() const { return video_modes.get(m_best_mode); }
+	modeline *current_mode() const { return video_modes.get(m_current_mode); }
 
 	// getters (display manager)
 	const char *monitor() { return (const char*) &m_ds.monitor; }
 	const char *user_modeline() { return (const char*) &m_ds.user_modeline; }
+	const char *mode_cache() { return (const char*) &m_ds.mode_cache; }
 	const char *crt_range(int i) { return (const char*) &m_ds.crt_range[i]; }
 	const char *lcd_range() { return (const char*) &m_ds.lcd_range; }
 	const char *screen() { return (const char*) &m_ds.screen; }
@@ -78,6 +154,7 @@ public:
 	bool lock_system_modes() { return m_ds.lock_system_modes; }
 	bool refresh_dont_care() { return m_ds.refresh_dont_care; }
 	bool keep_changes() { return m_ds.keep_changes; }
+	int mode_pool() { return m_ds.mode_pool; }
 	bool desktop_is_rotated() const { return m_desktop_is_rotated; }
 
 	// getters (modeline generator)
@@ -94,24 +171,40 @@ public:
 	int v_shift_correct() { return m_ds.gs.v_shift_correct; }
 	int pixel_precision() { return m_ds.gs.pixel_precision; }
 	int interlace_force_even() { return m_ds.gs.interlace_force_even; }
+	int timing_engine() { return m_ds.gs.timing_engine; }
+	double refresh_ppm() { return m_ds.gs.refresh_ppm; }
 
 	// getters (modeline result)
-	bool got_mode() { return (m_best_mode != nullptr); }
-	int width() { return m_best_mode != nullptr? m_best_mode->width : 0; }
-	int height() { return m_best_mode != nullptr? m_best_mode->height : 0; }
-	int refresh() { return m_best_mode != nullptr? m_best_mode->refresh : 0; }
-	double v_freq() { return m_best_mode != nullptr? m_best_mode->vfreq : 0; }
-	double h_freq() { return m_best_mode != nullptr? m_best_mode->hfreq : 0; }
-	int x_scale() { return m_best_mode != nullptr? m_best_mode->result.x_scale : 0; }
-	int y_scale() { return m_best_mode != nullptr? m_best_mode->result.y_scale : 0; }
-	int v_scale() { return m_best_mode != nullptr? m_best_mode->result.v_scale : 0; }
-	bool is_interlaced() { return m_best_mode != nullptr? m_best_mode->interlace : false; }
-	bool is_doublescanned() { return m_best_mode != nullptr? m_best_mode->doublescan : false; }
-	bool is_stretched() { return m_best_mode != nullptr? m_best_mode->result.weight & R_RES_STRETCH : false; }
-	bool is_refresh_off() { return m_best_mode != nullptr? m_best_mode->result.weight & R_V_FREQ_OFF : false; }
+	bool got_mode() { return (best_mode() != nullptr); }
+	int width() { return best_mode() != nullptr? best_mode()->width : 0; }
+	int height() { return best_mode() != nullptr? best_mode()->height : 0; }
+	int refresh() { return best_mode() != nullptr? best_mode()->refresh : 0; }
+	double v_freq() { return best_mode() != nullptr? best_mode()->vfreq : 0; }
+	double h_freq() { return best_mode() != nullptr? best_mode()->hfreq : 0; }
+	int x_scale() { return best_mode() != nullptr? best_mode()->result.x_scale : 0; }
+	int y_scale() { return best_mode() != nullptr? best_mode()->result.y_scale : 0; }
+	int v_scale() { return best_mode() != nullptr? best_mode()->result.v_scale : 0; }
+	bool is_interlaced() { return best_mode() != nullptr? best_mode()->interlace : false; }
+	bool is_doublescanned() { return best_mode() != nullptr? best_mode()->doublescan : false; }
+	bool is_stretched() { return best_mode() != nullptr? best_mode()->result.weight & R_RES_STRETCH : false; }
+	bool is_refresh_off() { return best_mode() != nullptr? best_mode()->result.weight & R_V_FREQ_OFF : false; }
 	bool is_switching_required() { return m_switching_required; }
-	bool is_mode_updated() { return m_best_mode != nullptr? m_best_mode->type & MODE_UPDATE : false; }
-	bool is_mode_new() { return m_best_mode != nullptr? m_best_mode->type & MODE_ADD : false; }
+	bool is_mode_updated() { return best_mode() != nullptr? best_mode()->type & MODE_UPDATE : false; }
+	bool is_mode_new() { return best_mode() != nullptr? best_mode()->type & MODE_ADD : false; }
+
+	// getters (mode cache)
+	int mode_cache_hits() const { return m_mode_cache_hits; }
+	int mode_cache_misses() const { return m_mode_cache_misses; }
+	int pruned_candidates() const { return m_pruned_candidates; }
+	int refresh_fast_path_hits() const { return m_refresh_fast_path; }
+	int applied_rank() const { return m_applied_rank; }
+	int rejected_timings() const { return m_rejected_timings.size(); }
+	void clear_mode_cache() { m_mode_cache.clear(); }
+
+	// candidate trace of the last search
+	bool mode_trace() const { return m_trace_enabled; }
+	void set_mode_trace(bool value);
+	void print_mode_trace();
 
 	// getters (custom_video backend)
 	bool screen_compositing() { return m_ds.vs.screen_compositing; }
@@ -122,16 +215,17 @@ public:
 	// setters
 	void set_index(int index) { m_index = index; }
 	void set_factory(custom_video *factory) { m_factory = factory; }
-	void set_custom_video(custom_video *video) { m_video = video; }
+	void set_custom_video(custom_video *video) { m_video = video; m_caps = -1; }
 	void set_has_ini(bool value) { m_has_ini = value; }
 
 	// setters (modes)
 	void set_user_mode(modeline *mode) { m_ds.user_mode = m_user_mode = *mode; filter_modes(); }
-	void set_current_mode(modeline *mode) { m_current_mode = mode; }
+	void set_current_mode(modeline *mode) { m_current_mode = video_modes.find(mode); }
 
 	// setters (display_manager)
 	void set_monitor(const char *preset) { strncpy(m_ds.monitor, preset, sizeof(m_ds.monitor)-1); }
 	void set_modeline(const char *modeline) { strncpy(m_ds.user_modeline, modeline, sizeof(m_ds.user_modeline)-1); }
+	void set_mode_cache(const char *file_name) { strncpy(m_ds.mode_cache, file_name, sizeof(m_ds.mode_cache)-1); }
 	void set_crt_range(int i, const char *range) { strncpy(m_ds.crt_range[i], range, sizeof(m_ds.crt_range[i])-1); }
 	void set_lcd_range(const char *range) { strncpy(m_ds.lcd_range, range, sizeof(m_ds.lcd_range)-1); }
 	void set_screen(const char *screen) { strncpy(m_ds.screen, screen, sizeof(m_ds.screen)-1); }
@@ -141,6 +235,7 @@ public:
 	void set_lock_system_modes(bool value) { m_ds.lock_system_modes = value; }
 	void set_refresh_dont_care(bool value) { m_ds.refresh_dont_care = value; }
 	void set_keep_changes(bool value) { m_ds.keep_changes = value; }
+	void set_mode_pool(int value) { m_ds.mode_pool = value; }
 	void set_desktop_is_rotated(bool value) { m_desktop_is_rotated = value; }
 
 	// setters (modeline generator)
@@ -157,6 +252,8 @@ public:
 	void set_v_shift_correct(int value) { m_ds.gs.v_shift_correct = value; }
 	void set_pixel_precision(int value) { m_ds.gs.pixel_precision = value; }
 	void set_interlace_force_even(int value) { m_ds.gs.interlace_force_even = value; }
+	void set_timing_engine(int value) { m_ds.gs.timing_engine = value; }
+	void set_refresh_ppm(double value) { m_ds.gs.refresh_ppm = value; }
 
 	// setters (custom_video backend)
 	void set_screen_compositing(bool value) { m_ds.vs.screen_compositing = value; }
@@ -169,9 +266,17 @@ public:
 
 	// mode setting interface
 	modeline *get_mode(int width, int height, float refresh, bool interlaced);
+	modeline *get_mode(int width, int height, float refresh, bool interlaced, std::chrono::steady_clock::time_point deadline, bool *complete = nullptr);
+	int get_modes(const std::vector<mode_request> &requests, std::vector<modeline> &results);
+	int get_top_modes(const mode_request &request, int k, std::vector<modeline> &modes);
+	int build_mode_cache(const std::vector<mode_request> &requests);
+	int prewarm_modes(const std::vector<mode_request> &requests);
+	int find_mode(int width, int height, int refresh, bool interlace);
 	bool add_mode(modeline *mode);
 	bool delete_mode(modeline *mode);
 	bool update_mode(modeline *mode);
+	bool adjust_geometry(double h_size, int h_shift, int v_shift);
+	bool apply_best_mode();
 	virtual bool set_mode(modeline *);
 	void log_mode(modeline *mode);
 
@@ -181,23 +286,133 @@ public:
 	bool flush_modes();
 	bool auto_specs();
 
-	// mode list
-	std::vector<modeline> video_modes = {};
-	std::vector<modeline> backup_modes = {};
+	// mode list, its entries stay in place while they're in it
+	mode_table video_modes;
 	modeline desktop_mode = {};
 
 	// monitor preset
-	monitor_range range[MAX_RANGES];
+	monitor_range range[MAX_RANGES] = {};
 
 private:
 
+	modeline *solve_mode(const mode_request &request, mode_budget *budget);
+	void solve_modes(const std::vector<mode_request> &requests, std::vector<mode_cache_entry> &entries);
+	int find_best_mode(const mode_request &request, modeline *best_mode, const generator_settings *gs, int caps, bool trace, std::vector<mode_candidate> *top = nullptr, size_t top_k = 0, mode_budget *budget = nullptr);
+	int find_best_mode_parallel(const mode_request &request, modeline *best_mode, const generator_settings *gs, int caps);
+	void search_order(const modeline *s_mode, int num_modes, bool locked, std::vector<int> &order);
+	void finish_mode(modeline *best_mode, const modeline *target, generator_settings *gs, modeline *base_mode = nullptr);
+	void finish_refresh(modeline *mode, double target, const generator_settings *gs);
+	int reuse_mode(int index, modeline *best_mode);
+	int refresh_only_mode(const mode_request &request, uint64_t search, modeline *best_mode);
+	bool entry_gives_mode(const mode_request &request, int index, const modeline *base_mode, bool added);
+	void source_mode(const mode_request &request, const generator_settings *gs, modeline *s_mode);
+	modeline template_mode(const modeline *mode, const modeline *s_mode);
+	uint64_t settings_hash();
+	uint64_t search_hash();
+	uint64_t mode_cache_key(const mode_request &request, uint64_t search);
+	uint64_t mode_file_key(const mode_request &request, uint64_t search);
+	uint64_t timing_key(const modeline *mode, bool solved);
+	bool is_rejected(const modeline *mode, bool solved);
+	void reject_best_mode();
+	bool next_fallback_mode();
+	void trace_add(int kind, int mode_index, int range, const modeline *mode);
+	void index_modes();
+	void sync_mode_index();
+	void index_mode(int i);
+	void unindex_mode(int i);
+	void reindex_mode(int i);
+	void table_changed(size_t i);
+	void table_truncated(size_t size);
+	void erase_mode(int i);
+	void erase_modes(const std::vector<int> &list);
+	void journal_add(int i);
+	void journal_update(int i);
+	void journal_delete(int i);
+	void compact_journal();
+	bool is_own_mode(int i);
+	void pool_mode(int i);
+	void touch_mode(int i);
+	int evict_modes(int count);
+	void update_ranges();
+
 	// custom video backend
 	custom_video *m_factory = 0;
 	custom_video *m_video = 0;
 
 	modeline m_user_mode = {};
-	modeline *m_best_mode = 0;
-	modeline *m_current_mode = 0;
+	mode_handle m_best_mode = {};
+	mode_handle m_current_mode = {};
+
+	// backend capabilities, read once the backend is set
+	int m_caps = -1;
+
+	// video_modes entries by resolution in ascending order, the key each entry
+	// is filed under and the entries the search may pick. Entries appended or
+	// dropped at the end of the list are picked up on the next lookup, other
+	// changes go through the index functions
+	std::unordered_map<uint64_t, std::vector<int>> m_mode_index;
+	std::vector<uint64_t> m_mode_keys;
+	std::vector<int> m_unlocked_modes;
+
+	// identifies the mode list as a search result depends on it, its pending
+	// MODE_ADD and MODE_UPDATE flags aside. Every change gets a new one, but
+	// dropping entries appended at the end gives back the one the shorter list
+	// had, kept here by list size
+	uint64_t m_table_generation = 0;
+	uint64_t m_table_generations = 0;
+	std::vector<std::pair<size_t, uint64_t>> m_shorter_generations;
+
+	// what we changed in the mode list, oldest first, for restore_modes. Mode
+	// list entries mark their change. Records of entries that left the list
+	// are dropped once the journal doubles
+	std::vector<mode_change> m_mode_journal;
+	size_t m_journal_limit = MODE_JOURNAL_SLACK;
+
+	// modes we added that reached the driver, only kept with mode_pool set
+	std::vector<pooled_mode> m_mode_pool;
+	uint64_t m_mode_pool_clock = 0;
+
+	// best mode as solved, before geometry adjustments
+	modeline m_geometry_base = {};
+
+	// best mode entry as the backend has it, and the candidates to try if the
+	// backend rejects it
+	modeline m_applied_entry = {};
+	std::vector<mode_candidate> m_fallback_modes;
+	bool m_fallbacks_built = false;
+	int m_applied_rank = 0;
+
+	// timings the backend rejected, left out of the search for the rest of the session
+	std::unordered_set<uint64_t> m_rejected_timings;
+
+	// results of previous get_mode calls, keyed by request and settings
+	std::unordered_map<uint64_t, mode_cache_entry> m_mode_cache;
+	int m_mode_cache_hits = 0;
+	int m_mode_cache_misses = 0;
+	std::atomic<int> m_pruned_candidates{0};
+	mode_cache_file m_mode_cache_file;
+
+	// last solved request, for the refresh only fast path
+	mode_request m_last_request = {};
+	uint64_t m_last_search = 0;
+	uint64_t m_last_generation = 0;
+	int m_last_index = -1;
+	int m_last_range = 0;
+	int m_last_weight = 0;
+	double m_last_v_diff = 0;
+	int m_refresh_fast_path = 0;
+
+	// populated monitor ranges as arrays, rebuilt whenever the ranges are set
+	range_set m_range_set = {};
+
+	// per range lookup tables, the populated ranges point into them
+	range_lut m_range_lut[MAX_RANGES] = {};
+	std::vector<double> m_range_lut_data;
+
+	// ring buffer of candidate records, only filled when tracing
+	std::vector<mode_trace_record> m_trace;
+	size_t m_trace_count = 0;
+	bool m_trace_enabled = false;
 
 	int m_index = 0;
 	bool m_desktop_is_rotated = 0;
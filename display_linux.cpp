@@ -62,9 +62,11 @@ bool linux_display::init(void* pfdata)
 	if (!video() or !video()->init())
 		return false;
 
+	update_constraints();
+	open_mode_cache();
+
 	// Build our display's mode list
 	video_modes.clear();
-	backup_modes.clear();
 	get_desktop_mode();
 	get_available_video_modes();
 
@@ -152,14 +154,13 @@ int linux_display::get_available_video_modes()
 
 		// set the desktop mode
 		if (mode.type & MODE_DESKTOP)
-		{
 			memcpy(&desktop_mode, &mode, sizeof(modeline));
-			if (current_mode() == nullptr)
-				set_current_mode(&mode);
-		}
 
 		video_modes.push_back(mode);
-		backup_modes.push_back(mode);
+
+		// it's our current mode until we set one, as stored in our list
+		if ((mode.type & MODE_DESKTOP) && current_mode() == nullptr)
+			set_current_mode(&video_modes.back());
 
 		log_verbose("Switchres: [%3ld] %4dx%4d @%3d%s%s %s: ", video_modes.size(), mode.width, mode.height, mode.refresh, mode.interlace ? "i" : "p", mode.type & MODE_DESKTOP ? "*" : "", mode.type & MODE_ROTATED ? "rot" : "");
 		log_mode(&mode);
@@ -136,9 +136,11 @@ bool sdl2_display::init(void* pf_data)
 	set_custom_video(factory()->make(m_ds.screen, NULL, method, &m_ds.vs));
 	if (!video() or !video()->init())
 		return false;
+
+	update_constraints();
+	open_mode_cache();
 	// Build our display's mode list
 	video_modes.clear();
-	backup_modes.clear();
 	//No need to call get_desktop_mode() SDL2 will restore the desktop mode itself
 	get_available_video_modes();
 
@@ -284,14 +286,13 @@ int sdl2_display::get_available_video_modes()
 
 		// set the desktop mode
 		if (mode.type & MODE_DESKTOP)
-		{
 			memcpy(&desktop_mode, &mode, sizeof(modeline));
-			if (current_mode() == nullptr)
-				set_current_mode(&mode);
-		}
 
 		video_modes.push_back(mode);
-		backup_modes.push_back(mode);
+
+		// it's our current mode until we set one, as stored in our list
+		if ((mode.type & MODE_DESKTOP) && current_mode() == nullptr)
+			set_current_mode(&video_modes.back());
 
 		log_verbose("Switchres/SDL2: [%3ld] %4dx%4d @%3d%s%s %s: ", video_modes.size(), mode.width, mode.height, mode.refresh, mode.interlace ? "i" : "p", mode.type & MODE_DESKTOP ? "*" : "", mode.type & MODE_ROTATED ? "rot" : "");
 		log_mode(&mode);
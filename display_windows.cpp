@@ -155,10 +155,11 @@ bool windows_display::init(void*)
 	set_factory(new custom_video);
 	set_custom_video(factory()->make(m_device_name, m_device_id, method, &m_ds.vs));
 	if (video()) video()->init();
+	update_constraints();
+	open_mode_cache();
 
 	// Build our display's mode list
 	video_modes.clear();
-	backup_modes.clear();
 	get_desktop_mode();
 	get_available_video_modes();
 	if (!strcmp(m_ds.monitor, "lcd")) auto_specs();
@@ -271,14 +272,12 @@ int windows_display::get_available_video_modes()
 			m.vfreq = m.refresh;
 			m.type |= lpDevMode.dmDisplayOrientation == DMDO_90 || lpDevMode.dmDisplayOrientation == DMDO_270? MODE_ROTATED : MODE_OK;
 
-			for (auto &mode : video_modes) if (mode.width == m.width && mode.height == m.height && mode.refresh == m.refresh && m.interlace == mode.interlace) goto found;
+			if (find_mode(m.width, m.height, m.refresh, m.interlace) >= 0) goto found;
 
 			if (m.width == desktop_mode.width && m.height == desktop_mode.height && m.refresh == desktop_mode.refresh && m.interlace == desktop_mode.interlace)
 			{
 				m.type |= MODE_DESKTOP;
 				if (m.type & MODE_ROTATED) set_desktop_is_rotated(true);
-				if (current_mode() == nullptr)
-				set_current_mode(&m);
 			}
 
 			log_verbose("Switchres: [%3d] %4dx%4d @%3d%s%s %s: ", k, m.width, m.height, m.refresh, m.interlace?"i":"p", m.type & MODE_DESKTOP?"*":"",  m.type & MODE_ROTATED?"rot":"");
@@ -298,7 +297,10 @@ int windows_display::get_available_video_modes()
 			if (m.type & MODE_DESKTOP) desktop_mode = m;
 
 			video_modes.push_back(m);
-			backup_modes.push_back(m);
+
+			// It's our current mode until we set one, as stored in our list
+			if ((m.type & MODE_DESKTOP) && current_mode() == nullptr)
+				set_current_mode(&video_modes.back());
 			k++;
 		}
 		found:
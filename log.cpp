@@ -55,6 +55,16 @@ void set_log_error(void *func_ptr)
 	log_error_bak = (LOG_ERROR)func_ptr;
 }
 
+bool log_verbose_enabled()
+{
+	return log_verbose != &log_dummy;
+}
+
+bool log_info_enabled()
+{
+	return log_info != &log_dummy;
+}
+
 void set_log_verbosity(int level)
 {
 	// Keep the log in the enum bounds
@@ -35,4 +35,8 @@ void set_log_verbose(void *func_ptr);
 void set_log_info(void *func_ptr);
 void set_log_error(void *func_ptr);
 
+// Whether messages are output at all, to skip formatting them when not
+bool log_verbose_enabled();
+bool log_info_enabled();
+
 #endif
@@ -0,0 +1,278 @@
+/**************************************************************
+
+   mode_cache.cpp - Persistent modeline cache
+
+   ---------------------------------------------------------
+
+   Switchres   Modeline generation engine for emulation
+
+   License     GPL-2.0+
+   Copyright   2010-2021 Chris Kennedy, Antonio Giner,
+                         Alexandre Wodarczyk, Gil Delescluse
+
+ **************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "mode_cache.h"
+#include "log.h"
+
+//============================================================
+//  record_checksum
+//============================================================
+
+static uint64_t record_checksum(const mode_cache_record *record)
+{
+	// FNV-1a over the key and the entry, the checksum field itself is skipped
+	uint64_t hash = 0xcbf29ce484222325 ^ record->key;
+	const unsigned char *data = (const unsigned char *)&record->entry;
+
+	for (size_t i = 0; i < sizeof(record->entry); i++)
+		hash = (hash ^ data[i]) * 0x100000001b3;
+
+	return hash;
+}
+
+//============================================================
+//  mode_cache_file::open
+//============================================================
+
+bool mode_cache_file::open(const char *file_name, uint64_t settings_hash)
+{
+	close();
+	snprintf(m_file_name, sizeof(m_file_name), "%s", file_name);
+
+	if (map_file())
+	{
+		const mode_cache_header *header = (const mode_cache_header *)m_data;
+
+		bool valid = m_size >= sizeof(mode_cache_header) && header->magic == MODE_CACHE_MAGIC && header->version == MODE_CACHE_VERSION
+			&& header->record_size == sizeof(mode_cache_record) && header->settings_hash == settings_hash;
+		size_t num_records = valid? (m_size - sizeof(mode_cache_header)) / sizeof(mode_cache_record) : 0;
+		size_t file_size = sizeof(mode_cache_header) + num_records * sizeof(mode_cache_record);
+
+		// A write cut short leaves a partial record at the end, records appended
+		// after it would be misaligned, so it goes before we map the file for good
+		if (valid && file_size != m_size)
+		{
+			log_verbose("Switchres: mode cache %s has a partial record, truncating it\n", m_file_name);
+			unmap_file();
+			valid = truncate_file(file_size) && map_file() && m_size == file_size;
+		}
+
+		if (valid)
+		{
+			// Index the records in place
+			const mode_cache_record *record = (const mode_cache_record *)(m_data + sizeof(mode_cache_header));
+
+			for (size_t i = 0; i < num_records; i++)
+				m_index[record[i].key] = &record[i];
+
+			log_verbose("Switchres: mode cache %s mapped, %d records\n", m_file_name, records());
+			return true;
+		}
+
+		log_verbose("Switchres: mode cache %s is stale or invalid, rebuilding it\n", m_file_name);
+		unmap_file();
+	}
+
+	// Start a new file for this monitor configuration
+	if (!create_file(settings_hash))
+	{
+		log_error("Switchres: can't create mode cache %s\n", m_file_name);
+		m_file_name[0] = 0;
+		return false;
+	}
+
+	return true;
+}
+
+//============================================================
+//  mode_cache_file::close
+//============================================================
+
+void mode_cache_file::close()
+{
+	unmap_file();
+	m_index.clear();
+	m_appended.clear();
+	m_file_name[0] = 0;
+}
+
+//============================================================
+//  mode_cache_file::find
+//============================================================
+
+const mode_cache_entry *mode_cache_file::find(uint64_t key, const mode_request &request) const
+{
+	auto it = m_index.find(key);
+	if (it == m_index.end())
+		return nullptr;
+
+	// Records are read straight from the mapping, just make sure they're sane
+	const mode_cache_record *record = it->second;
+	if (record->checksum != record_checksum(record))
+		return nullptr;
+
+	const mode_request *r = &record->entry.request;
+	if (r->width != request.width || r->height != request.height || r->refresh != request.refresh || r->interlace != request.interlace)
+		return nullptr;
+
+	return &record->entry;
+}
+
+//============================================================
+//  mode_cache_file::append
+//============================================================
+
+bool mode_cache_file::append(uint64_t key, const mode_cache_entry *entry)
+{
+	// Each key is written once per file, a record we already have stays
+	if (!is_open() || m_index.count(key))
+		return false;
+
+	mode_cache_record record;
+	memset(&record, 0, sizeof(record));
+	record.key = key;
+	record.entry = *entry;
+	record.checksum = record_checksum(&record);
+
+	// New records go to the file, the mapping keeps the contents it had on open
+	// so we index our own copy
+	FILE *file = fopen(m_file_name, "ab");
+	if (!file)
+		return false;
+
+	bool result = fwrite(&record, sizeof(record), 1, file) == 1;
+	fclose(file);
+
+	if (result)
+		m_index[key] = &(m_appended[key] = record);
+
+	return result;
+}
+
+//============================================================
+//  mode_cache_file::create_file
+//============================================================
+
+bool mode_cache_file::create_file(uint64_t settings_hash)
+{
+	mode_cache_header header;
+	memset(&header, 0, sizeof(header));
+	header.magic = MODE_CACHE_MAGIC;
+	header.version = MODE_CACHE_VERSION;
+	header.record_size = sizeof(mode_cache_record);
+	header.settings_hash = settings_hash;
+
+	FILE *file = fopen(m_file_name, "wb");
+	if (!file)
+		return false;
+
+	bool result = fwrite(&header, sizeof(header), 1, file) == 1;
+	fclose(file);
+
+	return result;
+}
+
+//============================================================
+//  mode_cache_file::truncate_file
+//============================================================
+
+bool mode_cache_file::truncate_file(size_t size)
+{
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(m_file_name, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER position;
+	position.QuadPart = size;
+	bool result = SetFilePointerEx(file, position, NULL, FILE_BEGIN) && SetEndOfFile(file);
+	CloseHandle(file);
+
+	return result;
+#else
+	return ::truncate(m_file_name, size) == 0;
+#endif
+}
+
+//============================================================
+//  mode_cache_file::map_file
+//============================================================
+
+bool mode_cache_file::map_file()
+{
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(m_file_name, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (mapping == NULL)
+		return false;
+
+	void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (data == NULL)
+		return false;
+
+	m_size = size.QuadPart;
+#else
+	int fd = ::open(m_file_name, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) < 0 || st.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (data == MAP_FAILED)
+		return false;
+
+	m_size = st.st_size;
+#endif
+
+	m_data = (const char *)data;
+	return true;
+}
+
+//============================================================
+//  mode_cache_file::unmap_file
+//============================================================
+
+void mode_cache_file::unmap_file()
+{
+	if (m_data == nullptr)
+		return;
+
+#if defined(_WIN32)
+	UnmapViewOfFile(m_data);
+#else
+	munmap((void *)m_data, m_size);
+#endif
+
+	m_data = nullptr;
+	m_size = 0;
+}
@@ -0,0 +1,96 @@
+/**************************************************************
+
+   mode_cache.h - Persistent modeline cache header
+
+   ---------------------------------------------------------
+
+   Switchres   Modeline generation engine for emulation
+
+   License     GPL-2.0+
+   Copyright   2010-2021 Chris Kennedy, Antonio Giner,
+                         Alexandre Wodarczyk, Gil Delescluse
+
+ **************************************************************/
+
+#ifndef __MODE_CACHE_H__
+#define __MODE_CACHE_H__
+
+#include <unordered_map>
+#include "modeline.h"
+
+//============================================================
+//  CONSTANTS
+//============================================================
+
+#define MODE_CACHE_MAGIC    0x4d435253 // "SRCM"
+#define MODE_CACHE_VERSION  6
+
+//============================================================
+//  TYPE DEFINITIONS
+//============================================================
+
+typedef struct mode_request
+{
+	int    width;
+	int    height;
+	float  refresh;
+	bool   interlace;
+} mode_request;
+
+typedef struct mode_cache_entry
+{
+	mode_request request;
+	int best_index;
+	modeline best_mode;
+	modeline base_mode;
+	generator_settings gs;
+} mode_cache_entry;
+
+typedef struct mode_cache_header
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t record_size;
+	uint32_t reserved;
+	uint64_t settings_hash;
+} mode_cache_header;
+
+typedef struct mode_cache_record
+{
+	uint64_t key;
+	uint64_t checksum;
+	mode_cache_entry entry;
+} mode_cache_record;
+
+
+class mode_cache_file
+{
+public:
+
+	mode_cache_file() {};
+	~mode_cache_file() { close(); }
+
+	bool open(const char *file_name, uint64_t settings_hash);
+	void close();
+
+	const mode_cache_entry *find(uint64_t key, const mode_request &request) const;
+	bool append(uint64_t key, const mode_cache_entry *entry);
+
+	bool is_open() const { return m_file_name[0] != 0; }
+	int records() const { return m_index.size(); }
+
+private:
+
+	char m_file_name[256] = {};
+	const char *m_data = nullptr;
+	size_t m_size = 0;
+	std::unordered_map<uint64_t, const mode_cache_record *> m_index;
+	std::unordered_map<uint64_t, mode_cache_record> m_appended;
+
+	bool map_file();
+	void unmap_file();
+	bool create_file(uint64_t settings_hash);
+	bool truncate_file(size_t size);
+};
+
+#endif
@@ -0,0 +1,221 @@
+/**************************************************************
+
+   mode_table.cpp - Mode list with stable entries
+
+   ---------------------------------------------------------
+
+   Switchres   Modeline generation engine for emulation
+
+   License     GPL-2.0+
+   Copyright   2010-2021 Chris Kennedy, Antonio Giner,
+                         Alexandre Wodarczyk, Gil Delescluse
+
+ **************************************************************/
+
+#include "mode_table.h"
+
+//============================================================
+//  mode_table::operator=
+//============================================================
+
+mode_table &mode_table::operator=(const mode_table &other)
+{
+	// Copies the entries, handles into either table aren't carried over
+	if (this != &other)
+	{
+		clear();
+		for (auto &mode : other)
+			push_back(mode);
+	}
+
+	return *this;
+}
+
+//============================================================
+//  mode_table::push_back
+//============================================================
+
+mode_handle mode_table::push_back(const modeline &mode)
+{
+	uint32_t s;
+
+	// All slots taken, add a block. Its first slot goes out first
+	if (m_free.empty())
+	{
+		m_blocks.emplace_back(new mode_slot[MODE_TABLE_BLOCK]);
+		for (int i = MODE_TABLE_BLOCK; i-- > 0; )
+		{
+			m_blocks.back()[i].generation = 1;
+			m_blocks.back()[i].position = -1;
+			m_free.push_back((m_blocks.size() - 1) * MODE_TABLE_BLOCK + i);
+		}
+	}
+
+	// Most recently freed slot first, it's likely still cached
+	s = m_free.back();
+	m_free.pop_back();
+
+	mode_slot &entry = slot(s);
+	entry.mode = mode;
+	entry.position = m_order.size();
+	entry.mark = -1;
+	m_order.push_back(s);
+
+	return { s, entry.generation };
+}
+
+//============================================================
+//  mode_table::pop_back
+//============================================================
+
+void mode_table::pop_back()
+{
+	release(m_order.back());
+	m_order.pop_back();
+}
+
+//============================================================
+//  mode_table::erase
+//============================================================
+
+void mode_table::erase(size_t i)
+{
+	release(m_order[i]);
+	m_order.erase(m_order.begin() + i);
+
+	for (; i < m_order.size(); i++)
+		slot(m_order[i]).position = i;
+}
+
+//============================================================
+//  mode_table::erase
+//============================================================
+
+void mode_table::erase(const std::vector<int> &positions)
+{
+	// Positions are ascending, the entries left keep their order
+	size_t e = 0, kept = 0;
+
+	for (size_t i = 0; i < m_order.size(); i++)
+	{
+		if (e < positions.size() && positions[e] == (int)i)
+		{
+			release(m_order[i]);
+			e++;
+			continue;
+		}
+
+		m_order[kept] = m_order[i];
+		slot(m_order[kept]).position = kept;
+		kept++;
+	}
+
+	m_order.resize(kept);
+}
+
+//============================================================
+//  mode_table::resize
+//============================================================
+
+void mode_table::resize(size_t n)
+{
+	while (m_order.size() > n)
+		pop_back();
+
+	while (m_order.size() < n)
+		push_back({});
+}
+
+//============================================================
+//  mode_table::clear
+//============================================================
+
+void mode_table::clear()
+{
+	resize(0);
+}
+
+//============================================================
+//  mode_table::handle
+//============================================================
+
+mode_handle mode_table::handle(size_t i) const
+{
+	if (i >= m_order.size())
+		return {};
+
+	return { m_order[i], slot(m_order[i]).generation };
+}
+
+//============================================================
+//  mode_table::find
+//============================================================
+
+mode_handle mode_table::find(const modeline *mode) const
+{
+	// Handle of the entry at this address, null if it isn't one of ours
+	uintptr_t address = (uintptr_t)mode;
+
+	for (size_t b = 0; b < m_blocks.size(); b++)
+	{
+		uintptr_t first = (uintptr_t)&m_blocks[b][0];
+		if (address < first || address >= first + MODE_TABLE_BLOCK * sizeof(mode_slot))
+			continue;
+
+		uint32_t s = b * MODE_TABLE_BLOCK + (address - first) / sizeof(mode_slot);
+		if (&slot(s).mode != mode || slot(s).position < 0)
+			return {};
+
+		return { s, slot(s).generation };
+	}
+
+	return {};
+}
+
+//============================================================
+//  mode_table::get
+//============================================================
+
+modeline *mode_table::get(mode_handle handle) const
+{
+	const mode_slot *entry = live_slot(handle);
+	return entry? &slot(handle.slot).mode : nullptr;
+}
+
+//============================================================
+//  mode_table::index
+//============================================================
+
+int mode_table::index(mode_handle handle) const
+{
+	const mode_slot *entry = live_slot(handle);
+	return entry? entry->position : -1;
+}
+
+//============================================================
+//  mode_table::live_slot
+//============================================================
+
+const mode_table::mode_slot *mode_table::live_slot(mode_handle handle) const
+{
+	if (handle.generation == 0 || handle.slot >= m_blocks.size() * MODE_TABLE_BLOCK)
+		return nullptr;
+
+	const mode_slot &entry = slot(handle.slot);
+	return entry.generation == handle.generation && entry.position >= 0? &entry : nullptr;
+}
+
+//============================================================
+//  mode_table::release
+//============================================================
+
+void mode_table::release(uint32_t s)
+{
+	// Outstanding handles to this slot stop resolving, generation 0 is skipped
+	mode_slot &entry = slot(s);
+	entry.position = -1;
+	if (++entry.generation == 0)
+		entry.generation = 1;
+
+	m_free.push_back(s);
+}
@@ -0,0 +1,124 @@
+/**************************************************************
+
+   mode_table.h - Mode list with stable entries header
+
+   ---------------------------------------------------------
+
+   Switchres   Modeline generation engine for emulation
+
+   License     GPL-2.0+
+   Copyright   2010-2021 Chris Kennedy, Antonio Giner,
+                         Alexandre Wodarczyk, Gil Delescluse
+
+ **************************************************************/
+
+#ifndef __MODE_TABLE_H__
+#define __MODE_TABLE_H__
+
+#include <vector>
+#include <memory>
+#include <iterator>
+#include <stddef.h>
+#include <stdint.h>
+#include "modeline.h"
+
+//============================================================
+//  CONSTANTS
+//============================================================
+
+// Entries per storage block. Blocks are only freed with the table, so an
+// entry never moves while it's in the list
+#define MODE_TABLE_BLOCK 64
+
+//============================================================
+//  TYPE DEFINITIONS
+//============================================================
+
+// Reference to a table entry. Once the entry is removed the handle resolves
+// to nothing, even if its slot holds a new entry. The zero handle is null
+typedef struct mode_handle
+{
+	uint32_t slot;
+	uint32_t generation;
+} mode_handle;
+
+class mode_table
+{
+public:
+	template <typename T, typename table_type> class list_iterator
+	{
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef modeline value_type;
+		typedef ptrdiff_t difference_type;
+		typedef T *pointer;
+		typedef T &reference;
+
+		list_iterator(table_type *table, size_t i) : m_table(table), m_i(i) {}
+		T &operator*() const { return (*m_table)[m_i]; }
+		T *operator->() const { return &(*m_table)[m_i]; }
+		list_iterator &operator++() { m_i++; return *this; }
+		bool operator==(const list_iterator &other) const { return m_i == other.m_i; }
+		bool operator!=(const list_iterator &other) const { return m_i != other.m_i; }
+
+	private:
+		table_type *m_table;
+		size_t m_i;
+	};
+
+	typedef list_iterator<modeline, mode_table> iterator;
+	typedef list_iterator<const modeline, const mode_table> const_iterator;
+
+	mode_table() {}
+	mode_table(const mode_table &other) { *this = other; }
+	mode_table &operator=(const mode_table &other);
+
+	// Entries in list order, as std::vector does
+	size_t size() const { return m_order.size(); }
+	bool empty() const { return m_order.empty(); }
+	modeline &operator[](size_t i) { return slot(m_order[i]).mode; }
+	const modeline &operator[](size_t i) const { return slot(m_order[i]).mode; }
+	modeline &back() { return (*this)[size() - 1]; }
+	iterator begin() { return iterator(this, 0); }
+	iterator end() { return iterator(this, size()); }
+	const_iterator begin() const { return const_iterator(this, 0); }
+	const_iterator end() const { return const_iterator(this, size()); }
+
+	// No entry is moved by these. Removing one from the middle shifts the
+	// list order of the ones after it, removing several shifts them in one pass
+	mode_handle push_back(const modeline &mode);
+	void pop_back();
+	void erase(size_t i);
+	void erase(const std::vector<int> &positions);
+	void resize(size_t n);
+	void clear();
+
+	// Handles, and their entry or list position if it's still in the list
+	mode_handle handle(size_t i) const;
+	mode_handle find(const modeline *mode) const;
+	modeline *get(mode_handle handle) const;
+	int index(mode_handle handle) const;
+
+	// A value kept with each entry for the table's owner, -1 for new entries
+	int mark(size_t i) const { return slot(m_order[i]).mark; }
+	void set_mark(size_t i, int value) { slot(m_order[i]).mark = value; }
+
+private:
+	typedef struct mode_slot
+	{
+		modeline mode;
+		uint32_t generation;
+		int      position;
+		int      mark;
+	} mode_slot;
+
+	mode_slot &slot(uint32_t s) const { return m_blocks[s / MODE_TABLE_BLOCK][s % MODE_TABLE_BLOCK]; }
+	const mode_slot *live_slot(mode_handle handle) const;
+	void release(uint32_t s);
+
+	std::vector<std::unique_ptr<mode_slot[]>> m_blocks;
+	std::vector<uint32_t> m_free;
+	std::vector<uint32_t> m_order;
+};
+
+#endif
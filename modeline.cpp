@@ -15,6 +15,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <cstddef>
+#include <climits>
 #include "modeline.h"
 #include "log.h"
 
@@ -26,20 +27,29 @@
 //  PROTOTYPES
 //============================================================
 
-int get_line_params(modeline *mode, monitor_range *range, int char_size);
+int get_line_params(modeline *mode, const monitor_range *range, int char_size);
 int scale_into_range (int value, int lower_limit, int higher_limit);
 int scale_into_range (double value, double lower_limit, double higher_limit);
 int scale_into_aspect (int source_res, int tot_res, double original_monitor_aspect, double users_monitor_aspect, double *best_diff);
-int stretch_into_range(double vfreq, monitor_range *range, double borders, bool interlace_allowed, double *interlace);
-int total_lines_for_yres(int yres, double vfreq, monitor_range *range, double borders, double interlace);
-double max_vfreq_for_yres (int yres, monitor_range *range, double borders, double interlace);
+int stretch_into_range(double vfreq, const monitor_range *range, double borders, bool interlace_allowed, double *interlace);
+int total_lines_for_yres(int yres, double vfreq, const monitor_range *range, double borders, double interlace);
+double max_vfreq_for_yres (int yres, const monitor_range *range, double borders, double interlace);
 
 //============================================================
-//  modeline_create
+//  modeline_generate
 //============================================================
 
-int modeline_create(modeline *s_mode, modeline *t_mode, monitor_range *range, generator_settings *cs)
+modeline modeline_generate(const modeline *s_mode, const modeline *t_mode, const monitor_range *range, const generator_settings *cs)
 {
+	if (cs->timing_engine == TIMING_ENGINE_FIXED)
+		return modeline_generate_fixed(s_mode, t_mode, range, cs);
+
+	// Work on a copy of the template, inputs are never written so this is safe to share across threads
+	modeline mode = *t_mode;
+
+	// When regenerating a mode from itself, the source follows the mode being built
+	const modeline *src = s_mode == t_mode? &mode : s_mode;
+
 	double vfreq_real = 0;
 	double interlace = 1;
 	double doublescan = 1;
@@ -53,37 +63,37 @@ int modeline_create(modeline *s_mode, modeline *t_mode, monitor_range *range, ge
 	double y_ratio = 0;
 	double x_ratio = 0;
 	double borders = 0;
-	t_mode->result.weight = 0;
+	mode.result.weight = 0;
 
 	// ≈≈≈ Vertical refresh ≈≈≈
 	// try to fit vertical frequency into current range
-	v_scale = scale_into_range(t_mode->vfreq, range->vfreq_min, range->vfreq_max);
+	v_scale = scale_into_range(mode.vfreq, range->vfreq_min, range->vfreq_max);
 
-	if (!v_scale && (t_mode->type & V_FREQ_EDITABLE))
+	if (!v_scale && (mode.type & V_FREQ_EDITABLE))
 	{
-		t_mode->vfreq = t_mode->vfreq < range->vfreq_min? range->vfreq_min : range->vfreq_max;
+		mode.vfreq = mode.vfreq < range->vfreq_min? range->vfreq_min : range->vfreq_max;
 		v_scale = 1;
 	}
-	else if (v_scale != 1 && !(t_mode->type & V_FREQ_EDITABLE))
+	else if (v_scale != 1 && !(mode.type & V_FREQ_EDITABLE))
 	{
-		t_mode->result.weight |= R_OUT_OF_RANGE;
-		return -1;
+		mode.result.weight |= R_OUT_OF_RANGE;
+		return mode;
 	}
 
 	// ≈≈≈ Vertical resolution ≈≈≈
 	// try to fit active lines in the progressive range first
-	if (range->progressive_lines_min && (!t_mode->interlace || (t_mode->type & SCAN_EDITABLE)))
-		y_scale = scale_into_range(t_mode->vactive, range->progressive_lines_min, range->progressive_lines_max);
+	if (range->progressive_lines_min && (!mode.interlace || (mode.type & SCAN_EDITABLE)))
+		y_scale = scale_into_range(mode.vactive, range->progressive_lines_min, range->progressive_lines_max);
 
 	// if not possible, try to fit in the interlaced range, if any
-	if (!y_scale && range->interlaced_lines_min && cs->interlace && (t_mode->interlace || (t_mode->type & SCAN_EDITABLE)))
+	if (!y_scale && range->interlaced_lines_min && cs->interlace && (mode.interlace || (mode.type & SCAN_EDITABLE)))
 	{
-		y_scale = scale_into_range(t_mode->vactive, range->interlaced_lines_min, range->interlaced_lines_max);
+		y_scale = scale_into_range(mode.vactive, range->interlaced_lines_min, range->interlaced_lines_max);
 		interlace = 2;
 	}
 
 	// if we succeeded, let's see if we can apply integer scaling
-	if (y_scale == 1 || (y_scale > 1 && (t_mode->type & Y_RES_EDITABLE)))
+	if (y_scale == 1 || (y_scale > 1 && (mode.type & Y_RES_EDITABLE)))
 	{
 		// check if we should apply doublescan
 		if (cs->doublescan && y_scale % 2 == 0)
@@ -95,33 +105,33 @@ int modeline_create(modeline *s_mode, modeline *t_mode, monitor_range *range, ge
 
 		// Calculate top border in case of multi-standard consumer TVs
 		if (cs->v_shift_correct)
-			borders = (range->progressive_lines_max - t_mode->vactive * y_scale / interlace) * (1.0 / range->hfreq_min) / 2;
+			borders = (range->progressive_lines_max - mode.vactive * y_scale / interlace) * (1.0 / range->hfreq_min) / 2;
 
 		// calculate expected achievable refresh for this height
-		vfreq_real = min(t_mode->vfreq * v_scale, max_vfreq_for_yres(t_mode->vactive * y_scale, range, borders, scan_factor));
-		if (vfreq_real != t_mode->vfreq * v_scale && !(t_mode->type & V_FREQ_EDITABLE))
+		vfreq_real = min(mode.vfreq * v_scale, max_vfreq_for_yres(mode.vactive * y_scale, range, borders, scan_factor));
+		if (vfreq_real != mode.vfreq * v_scale && !(mode.type & V_FREQ_EDITABLE))
 		{
-			t_mode->result.weight |= R_OUT_OF_RANGE;
-			return -1;
+			mode.result.weight |= R_OUT_OF_RANGE;
+			return mode;
 		}
 
 		// calculate the ratio that our scaled yres represents with respect to the original height
-		y_ratio = double(t_mode->vactive) * y_scale / s_mode->vactive;
-		int y_source_scaled = s_mode->vactive * floor(y_ratio);
+		y_ratio = double(mode.vactive) * y_scale / src->vactive;
+		int y_source_scaled = src->vactive * floor(y_ratio);
 
 		// if our original height doesn't fit the target height, we're forced to stretch
 		if (!y_source_scaled)
-			t_mode->result.weight |= R_RES_STRETCH;
+			mode.result.weight |= R_RES_STRETCH;
 
 		// otherwise we try to perform integer scaling
 		else
 		{
 			// exclude lcd ranges from raw border computation
-			if (t_mode->type & V_FREQ_EDITABLE && range->progressive_lines_max - range->progressive_lines_min > 0)
+			if (mode.type & V_FREQ_EDITABLE && range->progressive_lines_max - range->progressive_lines_min > 0)
 			{
 				// calculate y borders considering physical lines (instead of logical resolution)
-				int tot_yres = total_lines_for_yres(t_mode->vactive * y_scale, vfreq_real, range, borders, scan_factor);
-				int tot_source = total_lines_for_yres(y_source_scaled, t_mode->vfreq * v_scale, range, borders, scan_factor);
+				int tot_yres = total_lines_for_yres(mode.vactive * y_scale, vfreq_real, range, borders, scan_factor);
+				int tot_source = total_lines_for_yres(y_source_scaled, mode.vfreq * v_scale, range, borders, scan_factor);
 				y_diff = tot_yres > tot_source?double(tot_yres % tot_source) / tot_yres * 100:0;
 
 				// we penalize for the logical lines we need to add in order to meet the user's lower active lines limit
@@ -130,7 +140,7 @@ int modeline_create(modeline *s_mode, modeline *t_mode, monitor_range *range, ge
 				y_diff += double(tot_rest) / tot_yres * 100;
 			}
 			else
-				y_diff = double((t_mode->vactive * y_scale) % y_source_scaled) / (t_mode->vactive * y_scale) * 100;
+				y_diff = double((mode.vactive * y_scale) % y_source_scaled) / (mode.vactive * y_scale) * 100;
 
 			// we save the integer ratio between source and target resolutions, this will be used for prescaling
 			y_scale = floor(y_ratio);
@@ -138,168 +148,611 @@ int modeline_create(modeline *s_mode, modeline *t_mode, monitor_range *range, ge
 			// now if the borders obtained are low enough (< 10%) we'll finally apply integer scaling
 			// otherwise we'll stretch the original resolution over the target one
 			if (!(y_ratio >= 1.0 && y_ratio < 16.0 && y_diff < 10.0))
-				t_mode->result.weight |= R_RES_STRETCH;
+				mode.result.weight |= R_RES_STRETCH;
 		}
 	}
 
 	// otherwise, check if we're allowed to apply fractional scaling
-	else if (t_mode->type & Y_RES_EDITABLE)
-		t_mode->result.weight |= R_RES_STRETCH;
+	else if (mode.type & Y_RES_EDITABLE)
+		mode.result.weight |= R_RES_STRETCH;
 
 	// if there's nothing we can do, we're out of range
 	else
 	{
-		t_mode->result.weight |= R_OUT_OF_RANGE;
-		return -1;
+		mode.result.weight |= R_OUT_OF_RANGE;
+		return mode;
 	}
 
 	// ≈≈≈ Horizontal resolution ≈≈≈
 	// make the best possible adjustment of xres depending on what happened in the previous steps
 	// let's start with the SCALED case
-	if (!(t_mode->result.weight & R_RES_STRETCH))
+	if (!(mode.result.weight & R_RES_STRETCH))
 	{
 		// apply integer scaling to yres
-		if (t_mode->type & Y_RES_EDITABLE) t_mode->vactive *= y_scale;
+		if (mode.type & Y_RES_EDITABLE) mode.vactive *= y_scale;
 
 		// if we can, let's apply the same scaling to both directions
-		if (t_mode->type & X_RES_EDITABLE)
+		if (mode.type & X_RES_EDITABLE)
 		{
 			x_scale = y_scale;
 			double aspect_corrector = max(1.0f, cs->monitor_aspect / (cs->rotation? (1.0/(STANDARD_CRT_ASPECT)) : (STANDARD_CRT_ASPECT)));
-			t_mode->hactive = normalize(double(t_mode->hactive) * double(x_scale) * aspect_corrector, 8);
+			mode.hactive = normalize(double(mode.hactive) * double(x_scale) * aspect_corrector, 8);
 		}
 
 		// otherwise, try to get the best out of our current xres
 		else
 		{
-			x_scale = t_mode->hactive / s_mode->hactive;
+			x_scale = mode.hactive / src->hactive;
 			// if the source width fits our xres, try applying integer scaling
 			if (x_scale)
 			{
-				x_scale = scale_into_aspect(s_mode->hactive, t_mode->hactive, cs->rotation?1.0/(STANDARD_CRT_ASPECT):STANDARD_CRT_ASPECT, cs->monitor_aspect, &x_diff);
-				if (x_diff > 15.0 && t_mode->hactive < cs->super_width)
-						t_mode->result.weight |= R_RES_STRETCH;
+				x_scale = scale_into_aspect(src->hactive, mode.hactive, cs->rotation?1.0/(STANDARD_CRT_ASPECT):STANDARD_CRT_ASPECT, cs->monitor_aspect, &x_diff);
+				if (x_diff > 15.0 && mode.hactive < cs->super_width)
+						mode.result.weight |= R_RES_STRETCH;
 			}
 			// otherwise apply fractional scaling
 			else
-				t_mode->result.weight |= R_RES_STRETCH;
+				mode.result.weight |= R_RES_STRETCH;
 		}
 	}
 
 	// if the result was fractional scaling in any of the previous steps, deal with it
-	if (t_mode->result.weight & R_RES_STRETCH)
+	if (mode.result.weight & R_RES_STRETCH)
 	{
-		if (t_mode->type & Y_RES_EDITABLE)
+		if (mode.type & Y_RES_EDITABLE)
 		{
 			// always try to use the interlaced range first if it exists, for better resolution
-			t_mode->vactive = stretch_into_range(t_mode->vfreq * v_scale, range, borders, cs->interlace, &interlace);
+			mode.vactive = stretch_into_range(mode.vfreq * v_scale, range, borders, cs->interlace, &interlace);
 
 			// check in case we couldn't achieve the desired refresh
-			vfreq_real = min(t_mode->vfreq * v_scale, max_vfreq_for_yres(t_mode->vactive, range, borders, interlace));
+			vfreq_real = min(mode.vfreq * v_scale, max_vfreq_for_yres(mode.vactive, range, borders, interlace));
 		}
 
 		// check if we can create a normal aspect resolution
-		if (t_mode->type & X_RES_EDITABLE)
-			t_mode->hactive = max(t_mode->hactive, normalize(STANDARD_CRT_ASPECT * t_mode->vactive, 8));
+		if (mode.type & X_RES_EDITABLE)
+			mode.hactive = max(mode.hactive, normalize(STANDARD_CRT_ASPECT * mode.vactive, 8));
 
 		// calculate integer scale for prescaling
-		x_scale = max(1, scale_into_aspect(s_mode->hactive, t_mode->hactive, cs->rotation?1.0/(STANDARD_CRT_ASPECT):STANDARD_CRT_ASPECT, cs->monitor_aspect, &x_diff));
-		y_scale = max(1, floor(double(t_mode->vactive) / s_mode->vactive));
+		x_scale = max(1, scale_into_aspect(src->hactive, mode.hactive, cs->rotation?1.0/(STANDARD_CRT_ASPECT):STANDARD_CRT_ASPECT, cs->monitor_aspect, &x_diff));
+		y_scale = max(1, floor(double(mode.vactive) / src->vactive));
 
 		scan_factor = interlace;
 		doublescan = 1;
 	}
 
-	x_ratio = double(t_mode->hactive) / s_mode->hactive;
-	y_ratio = double(t_mode->vactive) / s_mode->vactive;
-	v_scale = max(round_near(vfreq_real / s_mode->vfreq), 1);
-	v_diff = (vfreq_real / v_scale) -  s_mode->vfreq;
+	x_ratio = double(mode.hactive) / src->hactive;
+	y_ratio = double(mode.vactive) / src->vactive;
+	v_scale = max(round_near(vfreq_real / src->vfreq), 1);
+	v_diff = (vfreq_real / v_scale) -  src->vfreq;
 	if (fabs(v_diff) > cs->refresh_tolerance)
-		t_mode->result.weight |= R_V_FREQ_OFF;
+		mode.result.weight |= R_V_FREQ_OFF;
 
 	// ≈≈≈ Modeline generation ≈≈≈
 	// compute new modeline if we are allowed to
-	if (t_mode->type & V_FREQ_EDITABLE)
+	if (mode.type & V_FREQ_EDITABLE)
 	{
 		double margin = 0;
 		double vblank_lines = 0;
 		double vvt_ini = 0;
 
 		// Get resulting refresh
-		t_mode->vfreq = vfreq_real;
+		mode.vfreq = vfreq_real;
 
 		// Get total vertical lines
-		vvt_ini = total_lines_for_yres(t_mode->vactive, t_mode->vfreq, range, borders, scan_factor) + (!cs->interlace_force_even && interlace == 2?0.5:0);
+		vvt_ini = total_lines_for_yres(mode.vactive, mode.vfreq, range, borders, scan_factor) + (!cs->interlace_force_even && interlace == 2?0.5:0);
 
 		// Calculate horizontal frequency
-		t_mode->hfreq = t_mode->vfreq * vvt_ini;
+		mode.hfreq = mode.vfreq * vvt_ini;
 
 		horizontal_values:
 
 		// Fill horizontal part of modeline
-		get_line_params(t_mode, range, cs->pixel_precision? 1 : 8);
+		get_line_params(&mode, range, cs->pixel_precision? 1 : 8);
+		mode.htotal = timing_align_htotal(mode.htotal, &cs->constraints);
 
 		// Calculate pixel clock
-		t_mode->pclock = t_mode->htotal * t_mode->hfreq;
-		if (t_mode->pclock <= cs->pclock_min)
+		mode.pclock = mode.htotal * mode.hfreq;
+		if (mode.pclock <= cs->pclock_min || mode.pclock < cs->constraints.pclock_min)
 		{
-			if (t_mode->type & X_RES_EDITABLE)
+			if (mode.type & X_RES_EDITABLE)
 			{
 				x_scale *= 2;
-				t_mode->hactive *= 2;
+				mode.hactive *= 2;
 				goto horizontal_values;
 			}
 			else
 			{
-				t_mode->result.weight |= R_OUT_OF_RANGE;
-				return -1;
+				mode.result.weight |= R_OUT_OF_RANGE;
+				return mode;
 			}
 		}
 
 		// Vertical blanking
-		t_mode->vtotal = vvt_ini * scan_factor;
-		vblank_lines = int(t_mode->hfreq * (range->vertical_blank + borders)) + (!cs->interlace_force_even && interlace == 2?0.5:0);
-		margin = (t_mode->vtotal - t_mode->vactive - vblank_lines * scan_factor) / (cs->v_shift_correct? 1 : 2);
+		mode.vtotal = vvt_ini * scan_factor;
+		vblank_lines = int(mode.hfreq * (range->vertical_blank + borders)) + (!cs->interlace_force_even && interlace == 2?0.5:0);
+		margin = (mode.vtotal - mode.vactive - vblank_lines * scan_factor) / (cs->v_shift_correct? 1 : 2);
 
-		double v_front_porch = margin + t_mode->hfreq * range->vfront_porch * scan_factor;
+		double v_front_porch = margin + mode.hfreq * range->vfront_porch * scan_factor;
 		int (*pf_round)(double) = interlace? (cs->interlace_force_even? round_near_even : round_near_odd) : round_near;
 
-		t_mode->vbegin = t_mode->vactive + max(pf_round(v_front_porch), 1);
-		t_mode->vend = t_mode->vbegin + max(round_near(t_mode->hfreq * range->vsync_pulse * scan_factor), 1);
+		mode.vbegin = mode.vactive + max(pf_round(v_front_porch), 1);
+		mode.vend = mode.vbegin + max(round_near(mode.hfreq * range->vsync_pulse * scan_factor), 1);
 
 		// Recalculate final vfreq
-		t_mode->vfreq = (t_mode->hfreq / t_mode->vtotal) * scan_factor;
+		mode.vfreq = (mode.hfreq / mode.vtotal) * scan_factor;
+
+		mode.hsync = range->hsync_polarity;
+		mode.vsync = range->vsync_polarity;
+		mode.interlace = interlace == 2?1:0;
+		mode.doublescan = doublescan == 1?0:1;
 
-		t_mode->hsync = range->hsync_polarity;
-		t_mode->vsync = range->vsync_polarity;
-		t_mode->interlace = interlace == 2?1:0;
-		t_mode->doublescan = doublescan == 1?0:1;
+		// Make it what the backend will actually produce
+		modeline_quantize_pclock(&mode, range, &cs->constraints);
+		if (!timing_within_limits(&mode, &cs->constraints))
+		{
+			mode.result.weight |= R_OUT_OF_RANGE;
+			return mode;
+		}
 	}
 
 	// finally, store result
-	t_mode->result.scan_penalty = (s_mode->interlace != t_mode->interlace? 1:0) + (s_mode->doublescan != t_mode->doublescan? 1:0);
-	t_mode->result.x_scale = x_scale;
-	t_mode->result.y_scale = y_scale;
-	t_mode->result.v_scale = v_scale;
-	t_mode->result.x_diff = x_diff;
-	t_mode->result.y_diff = y_diff;
-	t_mode->result.v_diff = v_diff;
-	t_mode->result.x_ratio = x_ratio;
-	t_mode->result.y_ratio = y_ratio;
-	t_mode->result.v_ratio = 0;
+	mode.result.scan_penalty = (src->interlace != mode.interlace? 1:0) + (src->doublescan != mode.doublescan? 1:0);
+	mode.result.x_scale = x_scale;
+	mode.result.y_scale = y_scale;
+	mode.result.v_scale = v_scale;
+	mode.result.x_diff = x_diff;
+	mode.result.y_diff = y_diff;
+	mode.result.v_diff = v_diff;
+	mode.result.x_ratio = x_ratio;
+	mode.result.y_ratio = y_ratio;
+	mode.result.v_ratio = 0;
+	mode.result.v_ppm = src->vfreq > 0? (mode.vfreq / (src->vfreq * v_scale) - 1.0) * 1e6 : 0;
+
+	return mode;
+}
+
+//============================================================
+//  modeline_weight_bound
+//============================================================
+
+int modeline_weight_bound(const modeline *s_mode, const modeline *t_mode, const monitor_range *range, const generator_settings *cs)
+{
+	// Returns the result weight bits that modeline_generate is certain to set for this
+	// mode and range, using only the cheap early steps. These must follow modeline_generate.
+	if (cs->timing_engine == TIMING_ENGINE_FIXED)
+		return modeline_weight_bound_fixed(s_mode, t_mode, range, cs);
+
+	int weight = 0;
+	double interlace = 1;
+	double doublescan = 1;
+	int y_scale = 0;
+
+	int v_scale = scale_into_range(t_mode->vfreq, range->vfreq_min, range->vfreq_max);
+
+	if (!v_scale && (t_mode->type & V_FREQ_EDITABLE))
+		v_scale = 1;
+
+	else if (v_scale != 1 && !(t_mode->type & V_FREQ_EDITABLE))
+		return R_OUT_OF_RANGE;
+
+	if (range->progressive_lines_min && (!t_mode->interlace || (t_mode->type & SCAN_EDITABLE)))
+		y_scale = scale_into_range(t_mode->vactive, range->progressive_lines_min, range->progressive_lines_max);
+
+	if (!y_scale && range->interlaced_lines_min && cs->interlace && (t_mode->interlace || (t_mode->type & SCAN_EDITABLE)))
+	{
+		y_scale = scale_into_range(t_mode->vactive, range->interlaced_lines_min, range->interlaced_lines_max);
+		interlace = 2;
+	}
+
+	if (y_scale == 1 || (y_scale > 1 && (t_mode->type & Y_RES_EDITABLE)))
+	{
+		if (cs->doublescan && y_scale % 2 == 0)
+		{
+			y_scale /= 2;
+			doublescan = 0.5;
+		}
+
+		// Fixed refresh modes must reach their refresh at this height
+		if (!(t_mode->type & V_FREQ_EDITABLE))
+		{
+			double borders = 0;
+			if (cs->v_shift_correct)
+				borders = (range->progressive_lines_max - t_mode->vactive * y_scale / interlace) * (1.0 / range->hfreq_min) / 2;
+
+			double vfreq_real = min(t_mode->vfreq * v_scale, max_vfreq_for_yres(t_mode->vactive * y_scale, range, borders, interlace * doublescan));
+			if (vfreq_real != t_mode->vfreq * v_scale)
+				return R_OUT_OF_RANGE;
+
+			// and if their height is fixed too, that refresh is final
+			if (!(t_mode->type & Y_RES_EDITABLE))
+			{
+				int v_scale_source = max(round_near(vfreq_real / s_mode->vfreq), 1);
+				if (fabs((vfreq_real / v_scale_source) - s_mode->vfreq) > cs->refresh_tolerance)
+					weight |= R_V_FREQ_OFF;
+			}
+		}
+
+		double y_ratio = double(t_mode->vactive) * y_scale / s_mode->vactive;
+		int y_source_scaled = s_mode->vactive * floor(y_ratio);
+		if (!y_source_scaled)
+			weight |= R_RES_STRETCH;
+	}
+
+	else if (t_mode->type & Y_RES_EDITABLE)
+		weight |= R_RES_STRETCH;
+
+	else
+		return R_OUT_OF_RANGE;
+
+	return weight;
+}
+
+//============================================================
+//  range_set_build
+//============================================================
+
+void range_set_build(range_set *set, const monitor_range *range)
+{
+	memset(set, 0, sizeof(range_set));
+
+	for (int i = 0; i < MAX_RANGES; i++)
+		if (range[i].hfreq_min)
+			set->index[set->count++] = i;
+
+	for (int k = 0; k < RANGE_SET_SIZE; k++)
+	{
+		const monitor_range *r = &range[set->index[k < set->count? k : max(set->count - 1, 0)]];
+
+		set->hfreq_min[k] = r->hfreq_min;
+		set->hfreq_max[k] = r->hfreq_max;
+		set->vfreq_min[k] = r->vfreq_min;
+		set->vfreq_max[k] = r->vfreq_max;
+		set->vertical_blank[k] = r->vertical_blank;
+		set->progressive_lines_min[k] = r->progressive_lines_min;
+		set->progressive_lines_max[k] = r->progressive_lines_max;
+		set->interlaced_lines_min[k] = r->interlaced_lines_min;
+		set->interlaced_lines_max[k] = r->interlaced_lines_max;
+	}
+}
+
+//============================================================
+//  range_lut_entries
+//============================================================
+
+static void range_lut_lines(const monitor_range *range, int *lines_min, int *lines_max)
+{
+	*lines_min = range->progressive_lines_min;
+	*lines_max = range->progressive_lines_max;
+
+	if (range->interlaced_lines_min)
+	{
+		*lines_min = *lines_min? min(*lines_min, range->interlaced_lines_min) : range->interlaced_lines_min;
+		*lines_max = max(*lines_max, range->interlaced_lines_max);
+	}
+}
+
+size_t range_lut_entries(const monitor_range *range)
+{
+	if (!range->hfreq_min)
+		return 0;
+
+	int lines_min, lines_max;
+	range_lut_lines(range, &lines_min, &lines_max);
+
+	return lines_min > 0 && lines_max >= lines_min? size_t(lines_max - lines_min + 1) * RANGE_LUT_SCANS : 0;
+}
+
+//============================================================
+//  range_lut_build
+//============================================================
+
+void range_lut_build(range_lut *lut, monitor_range *range, double *data)
+{
+	// data must hold range_lut_entries values, the range is linked to the table once it's filled
+	range->lut = nullptr;
+	range_lut_lines(range, &lut->lines_min, &lut->lines_max);
+	lut->hfreq_max = range->hfreq_max;
+	lut->vertical_blank = range->vertical_blank;
+	lut->max_vfreq = data;
+
+	const double scan_factors[RANGE_LUT_SCANS] = { 0.5, 1, 2 };
+	int lines = lut->lines_max - lut->lines_min + 1;
+
+	for (int s = 0; s < RANGE_LUT_SCANS; s++)
+		for (int y = 0; y < lines; y++)
+			data[s * lines + y] = max_vfreq_for_yres(lut->lines_min + y, range, 0, scan_factors[s]);
+
+	range->lut = lut;
+}
+
+//============================================================
+//  weight_bounds_kernel
+//============================================================
+
+// The vector helpers below write their results through references, a vector returned by value
+// gets a psabi note at the end of the unit that no pragma scoped to this block can silence
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+typedef double  v4df __attribute__((vector_size(RANGE_LANES * sizeof(double))));
+typedef int64_t v4di __attribute__((vector_size(RANGE_LANES * sizeof(int64_t))));
+typedef int32_t v4si __attribute__((vector_size(RANGE_LANES * sizeof(int32_t))));
+
+// Kernel flags, these hold for all the ranges
+#define WB_V_FREQ_EDITABLE  0x01
+#define WB_Y_RES_EDITABLE   0x02
+#define WB_PROGRESSIVE      0x04
+#define WB_INTERLACED       0x08
+#define WB_DOUBLESCAN       0x10
+#define WB_V_SHIFT_CORRECT  0x20
+
+// Built for AVX2 and SSE4.1 too where the loader can pick the best one at run time
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__)
+#define WB_TARGETS __attribute__((target_clones("avx2", "sse4.1", "default")))
+#else
+#define WB_TARGETS
+#endif
+
+static inline void v4df_load(v4df &v, const double *p) { memcpy(&v, p, sizeof(v)); }
+static inline void v4df_set(v4df &v, double x) { v = (v4df){ x, x, x, x }; }
+static inline bool v4di_any(const v4di &m) { return m[0] | m[1] | m[2] | m[3]; }
+static inline bool v4di_all(const v4di &m) { return m[0] & m[1] & m[2] & m[3]; }
+
+static inline void v4df_floor(v4df &r, const v4df &x)
+{
+	// Truncate through 32-bit ints and step down negative fractions, lanes out of int range go through floor()
+	r = __builtin_convertvector(__builtin_convertvector(x, v4si), v4df);
+	r = r > x? r - 1.0 : r;
+
+	if (__builtin_expect(v4di_any(!(x > -2147483648.0 && x < 2147483647.0)), 0))
+		for (int l = 0; l < RANGE_LANES; l++) r[l] = floor(x[l]);
+}
+
+static inline void v4df_ceil(v4df &r, const v4df &x) { v4df_floor(r, -x); r = -r; }
+
+static inline void v4df_round_near(v4df &r, const v4df &x)
+{
+	// As round_near, halves away from zero
+	v4df_floor(r, (x < 0.0? -x : x) + 0.5);
+	r = x < 0.0? -r : r;
+}
+
+static inline void v4df_scale_into_range(v4df &scale, const v4df &value, double value_inv, const v4df &lower_limit, const v4df &higher_limit)
+{
+	// As scale_into_range (int). Values already reaching the lower limit keep a scale of 1, otherwise the
+	// ceiling is estimated with the reciprocal, then settled on the exact products
+	v4df_set(scale, 1);
+	v4di below = value > 0.0 && value < lower_limit;
+
+	if (v4di_any(below))
+	{
+		v4df estimate;
+		v4df_ceil(estimate, lower_limit * value_inv);
+		estimate = estimate > 1.0 && value * (estimate - 1.0) >= lower_limit? estimate - 1.0 : estimate;
+		estimate = value * estimate < lower_limit? estimate + 1.0 : estimate;
+		scale = below? estimate : scale;
+	}
+
+	scale = value * scale <= higher_limit? scale : 0.0;
+}
+
+WB_TARGETS
+static void weight_bounds_kernel(const range_set *set, double vfreq, int vactive, int s_vactive, int flags, bool v_freq_off, int *weights)
+{
+	// Same steps as modeline_weight_bound, one lane per range. Divisions by the scan factors are
+	// done as products by their reciprocals, which are exact as they're all powers of two
+	v4df vf, va, s_va;
+	v4df_set(vf, vfreq);
+	v4df_set(va, vactive);
+	v4df_set(s_va, s_vactive);
+	const double va_inv = 1.0 / vactive;
+
+	for (int k = 0; k < set->count; k += RANGE_LANES)
+	{
+		v4df vfreq_min, vfreq_max, lines_min, lines_max, i_lines_min, i_lines_max;
+		v4df_load(vfreq_min, &set->vfreq_min[k]);
+		v4df_load(vfreq_max, &set->vfreq_max[k]);
+		v4df_load(lines_min, &set->progressive_lines_min[k]);
+		v4df_load(lines_max, &set->progressive_lines_max[k]);
+		v4df_load(i_lines_min, &set->interlaced_lines_min[k]);
+		v4df_load(i_lines_max, &set->interlaced_lines_max[k]);
+
+		v4di out_of_range = {};
+		v4di stretch = {};
+
+		// Fixed refresh modes must fit the range as they are
+		if (!(flags & WB_V_FREQ_EDITABLE))
+		{
+			out_of_range = !((vf <= 0.0 || vf >= vfreq_min) && vf <= vfreq_max);
+
+			if (v4di_all(out_of_range))
+			{
+				for (int l = 0; l < RANGE_LANES && k + l < set->count; l++)
+					weights[k + l] = R_OUT_OF_RANGE;
+				continue;
+			}
+		}
+
+		// Progressive range first, then the interlaced one
+		v4df y_scale, interlace_inv;
+		v4df_set(y_scale, 0);
+		v4df_set(interlace_inv, 1);
+
+		if (flags & WB_PROGRESSIVE)
+		{
+			v4df scale;
+			v4df_scale_into_range(scale, va, va_inv, lines_min, lines_max);
+			y_scale = lines_min != 0.0? scale : 0.0;
+		}
+
+		if (flags & WB_INTERLACED)
+		{
+			v4di use_interlaced = y_scale == 0.0 && i_lines_min != 0.0;
+			if (v4di_any(use_interlaced))
+			{
+				v4df scale;
+				v4df_scale_into_range(scale, va, va_inv, i_lines_min, i_lines_max);
+				y_scale = use_interlaced? scale : y_scale;
+				interlace_inv = use_interlaced? 0.5 : interlace_inv;
+			}
+		}
+
+		v4di fits = y_scale == 1.0;
+		if (flags & WB_Y_RES_EDITABLE)
+		{
+			fits |= y_scale > 1.0;
+			stretch |= ~fits;
+		}
+		else
+			out_of_range |= ~fits;
+
+		v4df scan_factor_inv = interlace_inv;
+		if (flags & WB_DOUBLESCAN)
+		{
+			v4df half;
+			v4df_floor(half, y_scale * 0.5);
+			v4di even = v4di_any(y_scale > 1.0)? y_scale * 0.5 == half : y_scale == 0.0;
+			y_scale = even? y_scale * 0.5 : y_scale;
+			scan_factor_inv = even? interlace_inv * 2.0 : interlace_inv;
+		}
+
+		v4df yres = va * y_scale;
+
+		// Fixed refresh modes must reach their refresh at this height
+		if (!(flags & WB_V_FREQ_EDITABLE))
+		{
+			v4df hfreq_max, vertical_blank, borders, blank_lines;
+			v4df_load(hfreq_max, &set->hfreq_max[k]);
+			v4df_load(vertical_blank, &set->vertical_blank[k]);
+			v4df_set(borders, 0);
+
+			if (flags & WB_V_SHIFT_CORRECT)
+			{
+				v4df hfreq_min;
+				v4df_load(hfreq_min, &set->hfreq_min[k]);
+				borders = (lines_max - yres * interlace_inv) * (1.0 / hfreq_min) / 2;
+			}
+
+			v4df_round_near(blank_lines, hfreq_max * (vertical_blank + borders));
+			v4df vfreq_max_yres = hfreq_max / (yres * scan_factor_inv + blank_lines);
+			v4df vfreq_real = vf < vfreq_max_yres? vf : vfreq_max_yres;
+			out_of_range |= fits & (vfreq_real != vf);
+		}
+
+		// The source height doesn't fit when the scaled ratio floors to 0, for positive heights
+		// that's simply a smaller product
+		if (vactive > 0 && s_vactive > 0)
+			stretch |= fits & (yres < s_va);
+		else
+		{
+			v4df y_source_scaled;
+			v4df_floor(y_source_scaled, yres / s_va);
+			y_source_scaled *= s_va;
+			stretch |= fits & (y_source_scaled < 1.0 && y_source_scaled > -1.0);
+		}
+
+		for (int l = 0; l < RANGE_LANES && k + l < set->count; l++)
+		{
+			if (out_of_range[l])
+				weights[k + l] = R_OUT_OF_RANGE;
+			else
+				weights[k + l] = (stretch[l]? R_RES_STRETCH : 0) | (fits[l] && v_freq_off? R_V_FREQ_OFF : 0);
+		}
+	}
+}
+
+#pragma GCC diagnostic pop
+
+//============================================================
+//  modeline_weight_bounds
+//============================================================
+
+void modeline_weight_bounds(const modeline *s_mode, const modeline *t_mode, const monitor_range *range, const range_set *set, const generator_settings *cs, int *weights)
+{
+	// modeline_weight_bound for every range in the set, weights are stored in set order. A single range
+	// has nothing to share a vector with, the scalar bound is cheaper there thanks to its early exits
+	if (cs->timing_engine == TIMING_ENGINE_FIXED || set->count == 1)
+	{
+		for (int k = 0; k < set->count; k++)
+			weights[k] = modeline_weight_bound(s_mode, t_mode, &range[set->index[k]], cs);
+		return;
+	}
+
+	int flags = 0;
+	if (t_mode->type & V_FREQ_EDITABLE) flags |= WB_V_FREQ_EDITABLE;
+	if (t_mode->type & Y_RES_EDITABLE) flags |= WB_Y_RES_EDITABLE;
+	if (!t_mode->interlace || (t_mode->type & SCAN_EDITABLE)) flags |= WB_PROGRESSIVE;
+	if (cs->interlace && (t_mode->interlace || (t_mode->type & SCAN_EDITABLE))) flags |= WB_INTERLACED;
+	if (cs->doublescan) flags |= WB_DOUBLESCAN;
+	if (cs->v_shift_correct) flags |= WB_V_SHIFT_CORRECT;
+
+	// A fixed refresh that fits is final when the height is fixed too, and the same for all ranges
+	bool v_freq_off = false;
+	if (!(t_mode->type & (V_FREQ_EDITABLE | Y_RES_EDITABLE)))
+	{
+		int v_scale_source = max(round_near(t_mode->vfreq / s_mode->vfreq), 1);
+		v_freq_off = fabs((t_mode->vfreq / v_scale_source) - s_mode->vfreq) > cs->refresh_tolerance;
+	}
+
+	weight_bounds_kernel(set, t_mode->vfreq, t_mode->vactive, s_mode->vactive, flags, v_freq_off, weights);
+}
+
+//============================================================
+//  modeline_create
+//============================================================
+
+int modeline_create(modeline *s_mode, modeline *t_mode, monitor_range *range, generator_settings *cs)
+{
+	*t_mode = modeline_generate(s_mode, t_mode, range, cs);
+	if (t_mode->result.weight & R_OUT_OF_RANGE)
+		return -1;
+
+	if (cs->refresh_ppm > 0)
+		modeline_refine_refresh(t_mode, range, cs, s_mode->vfreq * t_mode->result.v_scale);
 
 	return 0;
 }
 
+//============================================================
+//  line_param_grows
+//============================================================
+
+static inline bool line_param_grows(int chars, double char_time, double target, double target_min)
+{
+	// Stepping rule: grow while below the minimum or while one more char gets closer to the target
+	return chars * char_time < target_min ||
+		fabs((chars + 1) * char_time - target) < fabs(chars * char_time - target);
+}
+
+//============================================================
+//  line_param_fit
+//============================================================
+
+static inline int line_param_fit(int chars, double char_time, double chars_per_us, double target, double target_min)
+{
+	// First count from chars on where the stepping rule stops, estimated then settled on the exact rule
+	double estimate = max(ceil(target_min * chars_per_us), floor(target * chars_per_us + 0.5));
+	int fit = estimate > chars? (int)estimate : chars;
+
+	while (fit > chars && !line_param_grows(fit - 1, char_time, target, target_min))
+		fit--;
+
+	while (line_param_grows(fit, char_time, target, target_min))
+		fit++;
+
+	return fit;
+}
+
 //============================================================
 //  get_line_params
 //============================================================
 
-int get_line_params(modeline *mode, monitor_range *range, int char_size)
+int get_line_params(modeline *mode, const monitor_range *range, int char_size)
 {
 	int hhi, hhf, hht;
 	int hh, hs, he, ht;
-	double line_time, char_time, new_char_time;
+	int new_hs, new_he, new_ht;
+	double line_time, char_time;
 	double hfront_porch_min, hsync_pulse_min, hback_porch_min;
 
 	hfront_porch_min = range->hfront_porch * .90;
@@ -311,22 +764,31 @@ int get_line_params(modeline *mode, monitor_range *range, int char_size)
 	hh = round(mode->hactive / char_size);
 	hs = he = ht = 1;
 
-	do {
-		char_time = line_time / (hh + hs + he + ht);
-		if (hs * char_time < hfront_porch_min ||
-			fabs((hs + 1) * char_time - range->hfront_porch) < fabs(hs * char_time - range->hfront_porch))
-			hs++;
+	// The porches only grow as the char time shrinks, so instead of adding one char per pass
+	// we jump each porch to the count where the stepping rule stops for the current char time.
+	// This converges to the same (smallest) fixed point in a few passes. Each porch ends at 90%
+	// of its target or more, so the line has at least hh / (1 - porch_min / line_time) chars,
+	// the porches that fit that many are still below the fixed point and make the first pass
+	double porch_min = hfront_porch_min + hsync_pulse_min + hback_porch_min;
+	double chars = porch_min < line_time? max(floor(hh * line_time / (line_time - porch_min) * (1 - 1e-9)), hh + 3.0) : hh + 3.0;
+
+	for (;;)
+	{
+		char_time = line_time / chars;
+		double chars_per_us = chars * mode->hfreq / 1000000;
 
-		if (he * char_time < hsync_pulse_min ||
-			fabs((he + 1) * char_time - range->hsync_pulse) < fabs(he * char_time - range->hsync_pulse))
-			he++;
+		new_hs = line_param_fit(hs, char_time, chars_per_us, range->hfront_porch, hfront_porch_min);
+		new_he = line_param_fit(he, char_time, chars_per_us, range->hsync_pulse, hsync_pulse_min);
+		new_ht = line_param_fit(ht, char_time, chars_per_us, range->hback_porch, hback_porch_min);
 
-		if (ht * char_time < hback_porch_min ||
-			fabs((ht + 1) * char_time - range->hback_porch) < fabs(ht * char_time - range->hback_porch))
-			ht++;
+		if (new_hs == hs && new_he == he && new_ht == ht)
+			break;
 
-		new_char_time = line_time / (hh + hs + he + ht);
-	} while (new_char_time != char_time);
+		hs = new_hs;
+		he = new_he;
+		ht = new_ht;
+		chars = hh + hs + he + ht;
+	}
 
 	hhi = (hh + hs) * char_size;
 	hhf = (hh + hs + he) * char_size;
@@ -339,14 +801,196 @@ int get_line_params(modeline *mode, monitor_range *range, int char_size)
 	return 0;
 }
 
+//============================================================
+//  first_multiple_reaching
+//============================================================
+
+static inline int first_multiple_reaching(double value, double limit, int from)
+{
+	// Smallest n >= from with value * n >= limit (value > 0), estimated by division
+	// and then settled on the exact product so rounding matches a linear search
+	double estimate = ceil(limit / value);
+	int n = estimate > from? (estimate < INT_MAX / 2? (int)estimate : INT_MAX / 2) : from;
+
+	while (n > from && value * (n - 1) >= limit)
+		n--;
+
+	while (value * n < limit)
+		n++;
+
+	return n;
+}
+
+//============================================================
+//  timing_align_htotal
+//============================================================
+
+int timing_align_htotal(int htotal, const timing_constraints *tc)
+{
+	// The extra pixels go to the back porch
+	if (tc->htotal_align <= 1)
+		return htotal;
+
+	return (htotal + tc->htotal_align - 1) / tc->htotal_align * tc->htotal_align;
+}
+
+//============================================================
+//  timing_within_limits
+//============================================================
+
+bool timing_within_limits(const modeline *mode, const timing_constraints *tc)
+{
+	if (tc->pclock_min && mode->pclock < tc->pclock_min) return false;
+	if (tc->pclock_max && mode->pclock > tc->pclock_max) return false;
+	if (tc->htotal_max && mode->htotal > tc->htotal_max) return false;
+	if (tc->vtotal_max && mode->vtotal > tc->vtotal_max) return false;
+
+	return true;
+}
+
+//============================================================
+//  modeline_quantize_pclock
+//============================================================
+
+static inline bool pclock_in_range(uint64_t pclock, int htotal, const monitor_range *range)
+{
+	double hfreq = double(pclock) / htotal;
+	return pclock && hfreq >= range->hfreq_min && hfreq <= range->hfreq_max;
+}
+
+void modeline_quantize_pclock(modeline *mode, const monitor_range *range, const timing_constraints *tc)
+{
+	// Round the pixel clock to the backend's clock step, preferring the one
+	// that keeps the line frequency in range, and get the rates it produces
+	if (tc->pclock_quantum <= 1 || !mode->htotal || !mode->pclock)
+		return;
+
+	uint64_t low = mode->pclock / tc->pclock_quantum * tc->pclock_quantum;
+	uint64_t high = low + tc->pclock_quantum;
+	uint64_t pclock = mode->pclock - low < high - mode->pclock? low : high;
+	uint64_t other = pclock == low? high : low;
+
+	if (!pclock || (!pclock_in_range(pclock, mode->htotal, range) && pclock_in_range(other, mode->htotal, range)))
+		pclock = other;
+
+	double hfreq = double(pclock) / mode->htotal;
+	mode->vfreq *= hfreq / mode->hfreq;
+	mode->hfreq = hfreq;
+	mode->pclock = pclock;
+}
+
+//============================================================
+//  modeline_refine_refresh
+//============================================================
+
+static inline int64_t div_round(int64_t a, int64_t b) { return (a + b / 2) / b; }
+
+static inline int64_t refresh_uhz(int64_t pclock, int64_t htotal, int64_t vtotal, int64_t scan2)
+{
+	// Refresh in µHz, scan2 is the frame to line rate factor in halves
+	return div_round(pclock * 500000 * scan2, htotal * vtotal);
+}
+
+bool modeline_refine_refresh(modeline *mode, const monitor_range *range, const generator_settings *cs, double target)
+{
+	// Look for integer totals next to the current ones and a pixel clock the backend can
+	// produce that get the refresh closer to target. Back porches change by a quarter at
+	// most and the rates stay in range. Candidates are tried from the smallest change, the
+	// first one within cs->refresh_ppm is taken, otherwise the closest. The math is integer
+	// (µHz), so both timing engines pick the same totals. Returns true if the mode changed.
+	if (!(mode->type & V_FREQ_EDITABLE) || (mode->result.weight & R_OUT_OF_RANGE) || mode->htotal <= 0 || mode->vtotal <= 0 || !mode->pclock || target <= 0)
+		return false;
+
+	const timing_constraints *tc = &cs->constraints;
+	const int64_t quantum = tc->pclock_quantum > 1? tc->pclock_quantum : 1;
+
+	// Frame to line rate factor, in halves: 2 progressive, 4 interlaced, 1 doublescan
+	const int64_t scan2 = max(1, round_near(2 * mode->vfreq * mode->vtotal / mode->hfreq));
+
+	const int64_t v_target = llround(target * 1e6);
+	const int64_t hfreq_min = llround(range->hfreq_min * 1e6), hfreq_max = llround(range->hfreq_max * 1e6);
+	const int64_t vfreq_min = llround(range->vfreq_min * 1e6), vfreq_max = llround(range->vfreq_max * 1e6);
+
+	int64_t best_error = llabs(refresh_uhz(mode->pclock, mode->htotal, mode->vtotal, scan2) - v_target);
+	int64_t budget = llround(cs->refresh_ppm * v_target / 1e6);
+	if (best_error <= budget)
+		return false;
+
+	int h_step = max(cs->pixel_precision? 1 : 8, tc->htotal_align);
+	int v_step = mode->interlace? 2 : 1;
+	// Porches shorter than four steps keep their total, the clock alone may still get closer
+	int h_reach = min((mode->htotal - mode->hend) / 4 / h_step, REFINE_MAX_STEPS);
+	int v_reach = min((mode->vtotal - mode->vend) / 4 / v_step, REFINE_MAX_STEPS);
+
+	int best_htotal = 0, best_vtotal = 0;
+	int64_t best_pclock = 0, best_hfreq = 0, best_vfreq = 0;
+
+	// 0, +1, -1, +2, -2... steps away
+	for (int i = 0; i <= 2 * v_reach && best_error > budget; i++)
+	{
+		int vtotal = mode->vtotal + v_step * ((i + 1) / 2) * (i % 2? 1 : -1);
+		if (vtotal <= mode->vend || (tc->vtotal_max && vtotal > tc->vtotal_max))
+			continue;
+
+		for (int j = 0; j <= 2 * h_reach && best_error > budget; j++)
+		{
+			int htotal = mode->htotal + h_step * ((j + 1) / 2) * (j % 2? 1 : -1);
+			if (htotal <= mode->hend || (tc->htotal_max && htotal > tc->htotal_max) || (tc->htotal_align > 1 && htotal % tc->htotal_align))
+				continue;
+
+			// The closest clock step for this pair of totals
+			int64_t pclock = div_round(v_target * htotal * vtotal, 500000 * scan2 * quantum) * quantum;
+			int64_t hfreq = pclock * 1000000 / htotal;
+			int64_t vfreq = refresh_uhz(pclock, htotal, vtotal, scan2);
+
+			if (hfreq < hfreq_min || hfreq > hfreq_max || vfreq < vfreq_min || vfreq > vfreq_max
+				|| uint64_t(pclock) <= cs->pclock_min || uint64_t(pclock) < tc->pclock_min || (tc->pclock_max && uint64_t(pclock) > tc->pclock_max))
+				continue;
+
+			int64_t error = llabs(vfreq - v_target);
+			if (error < best_error)
+			{
+				best_error = error;
+				best_htotal = htotal;
+				best_vtotal = vtotal;
+				best_pclock = pclock;
+				best_hfreq = hfreq;
+				best_vfreq = vfreq;
+			}
+		}
+	}
+
+	if (!best_pclock)
+		return false;
+
+	mode->htotal = best_htotal;
+	mode->vtotal = best_vtotal;
+	mode->pclock = best_pclock;
+	if (cs->timing_engine == TIMING_ENGINE_FIXED)
+	{
+		mode->hfreq = best_hfreq / 1e6;
+		mode->vfreq = best_vfreq / 1e6;
+	}
+	else
+	{
+		mode->hfreq = double(best_pclock) / best_htotal;
+		mode->vfreq = mode->hfreq / best_vtotal * scan2 / 2;
+	}
+	mode->result.v_ppm = (mode->vfreq / target - 1.0) * 1e6;
+	return true;
+}
+
 //============================================================
 //  scale_into_range
 //============================================================
 
 int scale_into_range (int value, int lower_limit, int higher_limit)
 {
+	// Smallest scale that reaches the lower limit
 	int scale = 1;
-	while (value * scale < lower_limit) scale ++;
+	if (value > 0 && value < lower_limit)
+		scale = (lower_limit + value - 1) / value;
+
 	if (value * scale <= higher_limit)
 		return scale;
 	else
@@ -359,8 +1003,7 @@ int scale_into_range (int value, int lower_limit, int higher_limit)
 
 int scale_into_range (double value, double lower_limit, double higher_limit)
 {
-	int scale = 1;
-	while (value * scale < lower_limit) scale ++;
+	int scale = value > 0? first_multiple_reaching(value, lower_limit, 1) : 1;
 	if (value * scale <= higher_limit)
 		return scale;
 	else
@@ -394,7 +1037,7 @@ int scale_into_aspect (int source_res, int tot_res, double original_monitor_aspe
 //  stretch_into_range
 //============================================================
 
-int stretch_into_range(double vfreq, monitor_range *range, double borders, bool interlace_allowed, double *interlace)
+int stretch_into_range(double vfreq, const monitor_range *range, double borders, bool interlace_allowed, double *interlace)
 {
 	int yres, lower_limit;
 
@@ -410,10 +1053,21 @@ int stretch_into_range(double vfreq, monitor_range *range, double borders, bool
 		lower_limit = range->progressive_lines_min;
 	}
 
-	while (yres > lower_limit && max_vfreq_for_yres(yres, range, borders, *interlace) < vfreq)
-		yres -= 8;
+	// Walk down in steps of 8 lines until the mode fits, max_vfreq_for_yres grows as yres
+	// shrinks so the first step that fits can be found by bisection
+	int lo = 0, hi = yres > lower_limit? (yres - lower_limit + 7) / 8 : 0;
+	while (lo < hi)
+	{
+		int mid = lo + (hi - lo) / 2;
+		int y = yres - mid * 8;
+
+		if (y <= lower_limit || max_vfreq_for_yres(y, range, borders, *interlace) >= vfreq)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
 
-	return yres;
+	return yres - lo * 8;
 }
 
 
@@ -421,19 +1075,34 @@ int stretch_into_range(double vfreq, monitor_range *range, double borders, bool
 //  total_lines_for_yres
 //============================================================
 
-int total_lines_for_yres(int yres, double vfreq, monitor_range *range, double borders, double interlace)
+int total_lines_for_yres(int yres, double vfreq, const monitor_range *range, double borders, double interlace)
 {
 	int vvt = max(yres / interlace + round_near(vfreq * yres / (interlace * (1.0 - vfreq * (range->vertical_blank + borders))) * (range->vertical_blank + borders)), 1);
-	while ((vfreq * vvt < range->hfreq_min) && (vfreq * (vvt + 1) < range->hfreq_max)) vvt++;
-	return vvt;
+	if (!(vfreq > 0))
+		return vvt;
+
+	// Add lines until hfreq_min is reached, without letting the next line go over hfreq_max
+	int vvt_min = first_multiple_reaching(vfreq, range->hfreq_min, vvt);
+	int vvt_max = first_multiple_reaching(vfreq, range->hfreq_max, vvt + 1) - 1;
+	return min(vvt_min, vvt_max);
 }
 
 //============================================================
 //  max_vfreq_for_yres
 //============================================================
 
-double max_vfreq_for_yres (int yres, monitor_range *range, double borders, double interlace)
+double max_vfreq_for_yres (int yres, const monitor_range *range, double borders, double interlace)
 {
+	// Precomputed, if this height has a table entry and the table still matches the range
+	const range_lut *lut = range->lut;
+	if (lut && borders == 0 && yres >= lut->lines_min && yres <= lut->lines_max &&
+		lut->hfreq_max == range->hfreq_max && lut->vertical_blank == range->vertical_blank)
+	{
+		int s = interlace == 1? 1 : interlace == 2? 2 : interlace == 0.5? 0 : -1;
+		if (s >= 0)
+			return lut->max_vfreq[s * (lut->lines_max - lut->lines_min + 1) + yres - lut->lines_min];
+	}
+
 	return range->hfreq_max / (yres / interlace + round_near(range->hfreq_max * (range->vertical_blank + borders)));
 }
 
@@ -480,46 +1149,90 @@ char * modeline_result(modeline *mode, char *result)
 }
 
 //============================================================
-//  modeline_compare
+//  double_order
 //============================================================
 
-int modeline_compare(modeline *t, modeline *best)
+static inline uint64_t double_order(double value)
+{
+	// Map a double to an unsigned integer with the same ordering, -0 and 0 share a key
+	uint64_t bits;
+	value += 0.0;
+	memcpy(&bits, &value, sizeof(bits));
+	return (bits & 0x8000000000000000ULL)? ~bits : bits | 0x8000000000000000ULL;
+}
+
+//============================================================
+//  modeline_is_vector
+//============================================================
+
+bool modeline_is_vector(const modeline *mode)
 {
-	bool vector = (t->hactive == (int)t->result.x_ratio);
+	return mode->hactive == (int)mode->result.x_ratio;
+}
 
-	if (t->result.weight < best->result.weight)
-		return 1;
+//============================================================
+//  modeline_score
+//============================================================
 
-	else if (t->result.weight <= best->result.weight)
+mode_score modeline_score(const modeline *mode, bool vector)
+{
+	// Pack the criteria of the candidate ordering into a key, in order of
+	// precedence. Stretched and vector modes are ranked by refresh difference,
+	// then height and width ratios (higher is better, hence the inverted bits).
+	// Integer scaled modes are ranked by scale and scan penalty, borders,
+	// x scale and refresh difference.
+	mode_score score = {};
+	const mode_result *r = &mode->result;
+	double v_diff = fabs(r->v_diff);
+
+	if (r->weight & R_RES_STRETCH || vector)
 	{
-		double t_v_diff = fabs(t->result.v_diff);
-		double b_v_diff = fabs(best->result.v_diff);
+		double y_score = r->y_ratio * (mode->interlace?(2.0/3.0):1.0);
 
-		if (t->result.weight & R_RES_STRETCH || vector)
-		{
-			double t_y_score = t->result.y_ratio * (t->interlace?(2.0/3.0):1.0);
-			double b_y_score = best->result.y_ratio * (best->interlace?(2.0/3.0):1.0);
+		score.key[0] = (uint64_t)(uint32_t)r->weight << 32;
+		score.key[1] = double_order(v_diff);
+		score.key[2] = ~double_order(y_score);
+		score.key[3] = ~double_order(r->x_ratio);
+	}
+	else
+	{
+		int y_score = r->y_scale + r->scan_penalty;
+		double xy_diff = roundf((r->x_diff + r->y_diff) * 100) / 100;
 
-			if  ((t_v_diff <  b_v_diff) ||
-				((t_v_diff == b_v_diff) && (t_y_score > b_y_score)) ||
-				((t_v_diff == b_v_diff) && (t_y_score == b_y_score) && (t->result.x_ratio > best->result.x_ratio)))
-					return 1;
-		}
-		else
-		{
-			int t_y_score = t->result.y_scale + t->result.scan_penalty;
-			int b_y_score = best->result.y_scale + best->result.scan_penalty;
-			double xy_diff = roundf((t->result.x_diff + t->result.y_diff) * 100) / 100;
-			double best_xy_diff = roundf((best->result.x_diff + best->result.y_diff) * 100) / 100;
-
-			if  ((t_y_score < b_y_score) ||
-				((t_y_score == b_y_score) && (xy_diff < best_xy_diff)) ||
-				((t_y_score == b_y_score) && (xy_diff == best_xy_diff) && (t->result.x_scale < best->result.x_scale)) ||
-				((t_y_score == b_y_score) && (xy_diff == best_xy_diff) && (t->result.x_scale == best->result.x_scale) && (t_v_diff <  b_v_diff)))
-					return 1;
-		}
+		score.key[0] = (uint64_t)(uint32_t)r->weight << 32 | ((uint32_t)y_score ^ 0x80000000);
+		score.key[1] = double_order(xy_diff);
+		score.key[2] = (uint32_t)r->x_scale ^ 0x80000000;
+		score.key[3] = double_order(v_diff);
 	}
-	return 0;
+
+	return score;
+}
+
+//============================================================
+//  mode_score_less
+//============================================================
+
+bool mode_score_less(const mode_score *a, const mode_score *b)
+{
+	for (int i = 0; i < 4; i++)
+		if (a->key[i] != b->key[i])
+			return a->key[i] < b->key[i];
+
+	return false;
+}
+
+//============================================================
+//  modeline_compare
+//============================================================
+
+int modeline_compare(modeline *t, modeline *best)
+{
+	// Both modes are ranked with the criteria that apply to the new one
+	bool vector = modeline_is_vector(t);
+	mode_score t_score = modeline_score(t, vector);
+	mode_score best_score = modeline_score(best, vector);
+
+	return mode_score_less(&t_score, &best_score);
 }
 
 //============================================================
@@ -678,84 +1391,161 @@ int modeline_to_monitor_range(monitor_range *range, modeline *mode)
 }
 
 //============================================================
-//  modeline_v_shift
+//  refit_horizontal
 //============================================================
 
-int modeline_adjust(modeline *mode, double hfreq_max, generator_settings *cs)
+static bool refit_horizontal(modeline *mode, double h_size, const generator_settings *cs)
 {
-	// If input values are out of range, they are fixed within range and returned in the cs struct.
+	// The horizontal part of regenerating a mode from itself, its vertical timings and line frequency
+	// are kept. Porches are taken from the mode, front and back ones scaled by h_size. Returns false
+	// if the full generator is needed (pixel clock below the minimum or out of the backend limits).
+	monitor_range range;
+	memset(&range, 0, sizeof(monitor_range));
+	modeline_to_monitor_range(&range, mode);
+
+	range.hfront_porch /= h_size;
+	range.hback_porch /= h_size;
+
+	modeline m = *mode;
+	get_line_params(&m, &range, cs->pixel_precision? 1 : 8);
+	m.htotal = timing_align_htotal(m.htotal, &cs->constraints);
+	m.pclock = m.htotal * m.hfreq;
+
+	if (m.pclock <= cs->pclock_min || m.pclock < cs->constraints.pclock_min)
+		return false;
+
+	modeline_quantize_pclock(&m, &range, &cs->constraints);
+	if (!timing_within_limits(&m, &cs->constraints))
+		return false;
+
+	*mode = m;
+	return true;
+}
+
+//============================================================
+//  apply_geometry
+//============================================================
+
+static modeline apply_geometry(const modeline *mode, double hfreq_max, const generator_settings *cs, generator_settings *cs_fixed, bool incremental)
+{
+	// If input values are out of range, they are fixed within range and returned in cs_fixed (if not null).
+	modeline m = *mode;
+	generator_settings s = *cs;
+
+	// The fixed point engine always takes the full path, so its results stay its own
+	if (s.timing_engine == TIMING_ENGINE_FIXED)
+		incremental = false;
 
 	// H size ajdustment, valid values 0.5-2.0
-	if (cs->h_size != 1.0f)
+	if (s.h_size != 1.0f)
 	{
-		if (cs->h_size > 2.0f)
-			cs->h_size = 2.0f;
-		else if (cs->h_size < 0.5f)
-			cs->h_size = 0.5f;
+		if (s.h_size > 2.0f)
+			s.h_size = 2.0f;
+		else if (s.h_size < 0.5f)
+			s.h_size = 0.5f;
 
-		monitor_range range;
-		memset(&range, 0, sizeof(monitor_range));
+		if (!incremental || !refit_horizontal(&m, s.h_size, &s))
+		{
+			monitor_range range;
+			memset(&range, 0, sizeof(monitor_range));
 
-		modeline_to_monitor_range(&range, mode);
+			modeline_to_monitor_range(&range, &m);
 
-		range.hfront_porch /= cs->h_size;
-		range.hback_porch /= cs->h_size;
+			range.hfront_porch /= s.h_size;
+			range.hback_porch /= s.h_size;
 
-		modeline_create(mode, mode, &range, cs);
+			m = modeline_generate(&m, &m, &range, &s);
+		}
 	}
 
 	// H shift adjustment, positive or negative value
-	if (cs->h_shift != 0)
+	if (s.h_shift != 0)
 	{
-		if (cs->h_shift >= mode->hbegin - mode->hactive)
-			cs->h_shift = mode->hbegin - mode->hactive - 1;
+		if (s.h_shift >= m.hbegin - m.hactive)
+			s.h_shift = m.hbegin - m.hactive - 1;
 
-		else if (cs->h_shift <= mode->hend - mode->htotal)
-			cs->h_shift = mode->hend - mode->htotal + 1;
+		else if (s.h_shift <= m.hend - m.htotal)
+			s.h_shift = m.hend - m.htotal + 1;
 
-		mode->hbegin -= cs->h_shift;
-		mode->hend -= cs->h_shift;
+		m.hbegin -= s.h_shift;
+		m.hend -= s.h_shift;
 	}
 
 	// V shift adjustment, positive or negative value
-	if (cs->v_shift != 0)
+	if (s.v_shift != 0)
 	{
-		int v_front_porch = mode->vbegin - mode->vactive;
-		int v_back_porch =  mode->vend - mode->vtotal;
-		int max_vtotal = hfreq_max / mode->vfreq * (mode->interlace? 2 : 1);
-		int border = max_vtotal - mode->vtotal;
+		int v_front_porch = m.vbegin - m.vactive;
+		int v_back_porch =  m.vend - m.vtotal;
+		int max_vtotal = hfreq_max / m.vfreq * (m.interlace? 2 : 1);
+		int border = max_vtotal - m.vtotal;
 		int padding = 0;
 
-		if (cs->v_shift >= v_front_porch)
+		if (s.v_shift >= v_front_porch)
 		{
 			int v_front_porch_ex = v_front_porch + border;
-			if (cs->v_shift >= v_front_porch_ex)
-				cs->v_shift = v_front_porch_ex - 1;
+			if (s.v_shift >= v_front_porch_ex)
+				s.v_shift = v_front_porch_ex - 1;
 
-			padding = cs->v_shift - v_front_porch + 1;
-			mode->vbegin += padding;
-			mode->vend += padding;
-			mode->vtotal += padding;
+			padding = s.v_shift - v_front_porch + 1;
+			m.vbegin += padding;
+			m.vend += padding;
+			m.vtotal += padding;
 		}
 
-		else if (cs->v_shift <= v_back_porch + 1)
-			cs->v_shift = v_back_porch + 2;
+		else if (s.v_shift <= v_back_porch + 1)
+			s.v_shift = v_back_porch + 2;
 
-		mode->vbegin -= cs->v_shift;
-		mode->vend -= cs->v_shift;
+		m.vbegin -= s.v_shift;
+		m.vend -= s.v_shift;
 
 		if (padding != 0)
 		{
-			mode->hfreq = mode->vfreq * mode->vtotal / (mode->interlace? 2.0 : 1.0);
+			m.hfreq = m.vfreq * m.vtotal / (m.interlace? 2.0 : 1.0);
 
-			monitor_range range;
-			memset(&range, 0, sizeof(monitor_range));
-			modeline_to_monitor_range(&range, mode);
-			monitor_show_range(&range);
-			modeline_create(mode, mode, &range, cs);
+			if (!incremental || !refit_horizontal(&m, 1.0, &s))
+			{
+				monitor_range range;
+				memset(&range, 0, sizeof(monitor_range));
+				modeline_to_monitor_range(&range, &m);
+				monitor_show_range(&range);
+				m = modeline_generate(&m, &m, &range, &s);
+			}
 		}
 	}
 
+	if (cs_fixed)
+		*cs_fixed = s;
+
+	return m;
+}
+
+//============================================================
+//  modeline_apply_geometry
+//============================================================
+
+modeline modeline_apply_geometry(const modeline *mode, double hfreq_max, const generator_settings *cs, generator_settings *cs_fixed)
+{
+	return apply_geometry(mode, hfreq_max, cs, cs_fixed, false);
+}
+
+//============================================================
+//  modeline_adjust_geometry
+//============================================================
+
+modeline modeline_adjust_geometry(const modeline *mode, double hfreq_max, const generator_settings *cs, generator_settings *cs_fixed)
+{
+	// As modeline_apply_geometry, but the vertical solution of the mode is kept and only the
+	// porches affected by the adjustments are solved again, for interactive geometry tuning
+	return apply_geometry(mode, hfreq_max, cs, cs_fixed, true);
+}
+
+//============================================================
+//  modeline_adjust
+//============================================================
+
+int modeline_adjust(modeline *mode, double hfreq_max, generator_settings *cs)
+{
+	*mode = modeline_apply_geometry(mode, hfreq_max, cs, cs);
 	return 0;
 }
 
@@ -763,12 +1553,35 @@ int modeline_adjust(modeline *mode, double hfreq_max, generator_settings *cs)
 //  modeline_is_different
 //============================================================
 
-int modeline_is_different(modeline *n, modeline *p)
+int modeline_is_different(const modeline *n, const modeline *p)
 {
 	// Remove on last fields in modeline comparison
 	return memcmp(n, p, offsetof(struct modeline, vfreq));
 }
 
+//============================================================
+//  modeline_timing_hash
+//============================================================
+
+uint64_t modeline_timing_hash(const modeline *mode)
+{
+	// Identity of a mode in the driver: a 64-bit hash of the fields compared
+	// by modeline_is_different, so equal timings always hash the same whatever
+	// the mode's name or list position
+	const int fields[] = { mode->hactive, mode->hbegin, mode->hend, mode->htotal, mode->vactive, mode->vbegin, mode->vend, mode->vtotal,
+		mode->interlace, mode->doublescan, mode->hsync, mode->vsync };
+
+	// FNV-1a over whole words, folding the high bits back in at each step
+	uint64_t hash = (0xcbf29ce484222325 ^ mode->pclock) * 0x100000001b3;
+	for (int field : fields)
+	{
+		hash ^= hash >> 32;
+		hash = (hash ^ uint64_t(uint32_t(field))) * 0x100000001b3;
+	}
+
+	return hash ^ (hash >> 29);
+}
+
 //============================================================
 //  monitor_fill_vesa_gtf
 //============================================================
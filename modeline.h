@@ -52,6 +52,21 @@
 #define SCAN_EDITABLE   0x00000008
 #define XYV_EDITABLE   (X_RES_EDITABLE | Y_RES_EDITABLE | V_FREQ_EDITABLE )
 
+// Timing engines
+#define TIMING_ENGINE_DOUBLE 0
+#define TIMING_ENGINE_FIXED  1
+
+// Monitor ranges are evaluated in groups of this many lanes
+#define RANGE_LANES 4
+#define RANGE_SET_SIZE ((MAX_RANGES + RANGE_LANES - 1) / RANGE_LANES * RANGE_LANES)
+
+// Memory allowed for the per range lookup tables of a display
+#define RANGE_LUT_MAX_BYTES (256 * 1024)
+#define RANGE_LUT_SCANS 3
+
+// Exact refresh search: totals are tried this many steps away at most, each way
+#define REFINE_MAX_STEPS 8
+
 #define DUMMY_WIDTH 1234
 #define MAX_MODELINES 256
 
@@ -72,6 +87,7 @@ typedef struct mode_result
 	double  x_ratio;
 	double  y_ratio;
 	double  v_ratio;
+	double  v_ppm;
 } mode_result;
 
 typedef struct modeline
@@ -105,6 +121,23 @@ typedef struct modeline
 	mode_result result;
 } modeline;
 
+// Ordering key for candidates: lower keys are better, compared word by word
+typedef struct mode_score
+{
+	uint64_t key[4];
+} mode_score;
+
+// Timing limits of a video backend, as its driver will store the mode. Zero means no limit
+typedef struct timing_constraints
+{
+	uint64_t pclock_quantum;
+	uint64_t pclock_min;
+	uint64_t pclock_max;
+	int      htotal_align;
+	int      htotal_max;
+	int      vtotal_max;
+} timing_constraints;
+
 typedef struct generator_settings
 {
 	int      interlace;
@@ -120,21 +153,71 @@ typedef struct generator_settings
 	int      v_shift_correct;
 	int      pixel_precision;
 	int      interlace_force_even;
+	int      timing_engine;
+	double   refresh_ppm;
+	timing_constraints constraints;
 } generator_settings;
 
+// The populated monitor ranges as arrays, so a mode can be checked on all of them at once.
+// Unused lanes repeat the last range.
+typedef struct range_set
+{
+	int    count;
+	int    index[RANGE_SET_SIZE];
+	double hfreq_min[RANGE_SET_SIZE];
+	double hfreq_max[RANGE_SET_SIZE];
+	double vfreq_min[RANGE_SET_SIZE];
+	double vfreq_max[RANGE_SET_SIZE];
+	double vertical_blank[RANGE_SET_SIZE];
+	double progressive_lines_min[RANGE_SET_SIZE];
+	double progressive_lines_max[RANGE_SET_SIZE];
+	double interlaced_lines_min[RANGE_SET_SIZE];
+	double interlaced_lines_max[RANGE_SET_SIZE];
+} range_set;
+
+// max_vfreq_for_yres of a monitor range without borders, for every height between its lowest and
+// highest line limits. Rows are scan factors 0.5, 1 and 2. The range values it depends on are kept
+// so a table that no longer matches its range is ignored.
+typedef struct range_lut
+{
+	int     lines_min;
+	int     lines_max;
+	double  hfreq_max;
+	double  vertical_blank;
+	double *max_vfreq;
+} range_lut;
+
 //============================================================
 //  PROTOTYPES
 //============================================================
 
+modeline modeline_generate(const modeline *s_mode, const modeline *t_mode, const monitor_range *range, const generator_settings *cs);
 int modeline_create(modeline *s_mode, modeline *t_mode, monitor_range *range, generator_settings *cs);
+int modeline_weight_bound(const modeline *s_mode, const modeline *t_mode, const monitor_range *range, const generator_settings *cs);
+void modeline_weight_bounds(const modeline *s_mode, const modeline *t_mode, const monitor_range *range, const range_set *set, const generator_settings *cs, int *weights);
+void range_set_build(range_set *set, const monitor_range *range);
+size_t range_lut_entries(const monitor_range *range);
+void range_lut_build(range_lut *lut, monitor_range *range, double *data);
+modeline modeline_generate_fixed(const modeline *s_mode, const modeline *t_mode, const monitor_range *range, const generator_settings *cs);
+int modeline_weight_bound_fixed(const modeline *s_mode, const modeline *t_mode, const monitor_range *range, const generator_settings *cs);
 int modeline_compare(modeline *t_mode, modeline *best_mode);
+bool modeline_is_vector(const modeline *mode);
+mode_score modeline_score(const modeline *mode, bool vector);
+bool mode_score_less(const mode_score *a, const mode_score *b);
 char * modeline_print(modeline *mode, char *modeline, int flags);
 char * modeline_result(modeline *mode, char *result);
 int modeline_vesa_gtf(modeline *m);
 int modeline_parse(const char *user_modeline, modeline *mode);
 int modeline_to_monitor_range(monitor_range *range, modeline *mode);
+int timing_align_htotal(int htotal, const timing_constraints *tc);
+bool timing_within_limits(const modeline *mode, const timing_constraints *tc);
+void modeline_quantize_pclock(modeline *mode, const monitor_range *range, const timing_constraints *tc);
+bool modeline_refine_refresh(modeline *mode, const monitor_range *range, const generator_settings *cs, double target);
+modeline modeline_apply_geometry(const modeline *mode, double hfreq_max, const generator_settings *cs, generator_settings *cs_fixed);
+modeline modeline_adjust_geometry(const modeline *mode, double hfreq_max, const generator_settings *cs, generator_settings *cs_fixed);
 int modeline_adjust(modeline *mode, double hfreq_max, generator_settings *cs);
-int modeline_is_different(modeline *n, modeline *p);
+int modeline_is_different(const modeline *n, const modeline *p);
+uint64_t modeline_timing_hash(const modeline *mode);
 
 int round_near(double number);
 int round_near_odd(double number);
@@ -0,0 +1,735 @@
+/**************************************************************
+
+   modeline_fixed.cpp - Fixed point modeline generation engine
+
+   ---------------------------------------------------------
+
+   Switchres   Modeline generation engine for emulation
+
+   License     GPL-2.0+
+   Copyright   2010-2021 Chris Kennedy, Antonio Giner,
+                         Alexandre Wodarczyk, Gil Delescluse
+
+ **************************************************************/
+
+// Same steps as modeline_generate, but all the timing math is done in 64-bit
+// integers: frequencies in µHz (Hz * 1e6) and times in ps (µs * 1e6). Range
+// values and the monitor aspect are quantized once on entry, from there on
+// results don't depend on the compiler, its floating point flags or the FPU.
+// Scale, stretch and aspect decisions are integer too, the ratios and diffs
+// the score reads are converted to double from exact integer values.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "modeline.h"
+#include "log.h"
+
+#define max(a,b)({ __typeof__ (a) _a = (a);__typeof__ (b) _b = (b);_a > _b ? _a : _b; })
+#define min(a,b)({ __typeof__ (a) _a = (a);__typeof__ (b) _b = (b);_a < _b ? _a : _b; })
+
+#define FX_ONE     1000000LL
+#define FX_LINES   (FX_ONE * FX_ONE * FX_ONE)   // µHz * ps per line
+#define FX_NONE    INT64_MAX
+
+//============================================================
+//  PROTOTYPES
+//============================================================
+
+int scale_into_range (int value, int lower_limit, int higher_limit);
+
+//============================================================
+//  TYPE DEFINITIONS
+//============================================================
+
+typedef struct fx_range
+{
+	int64_t hfreq_min;        // µHz
+	int64_t hfreq_max;
+	int64_t vfreq_min;
+	int64_t vfreq_max;
+	int64_t hfront_porch;     // ps
+	int64_t hsync_pulse;
+	int64_t hback_porch;
+	int64_t vfront_porch;
+	int64_t vsync_pulse;
+	int64_t vertical_blank;
+} fx_range;
+
+//============================================================
+//  fx_mul_div
+//============================================================
+
+static uint64_t mul_div_u64(uint64_t a, uint64_t b, uint64_t c, uint64_t bias)
+{
+	// (a * b + bias) / c with a 128-bit intermediate, the quotient must fit in 64 bits
+#if defined(__SIZEOF_INT128__)
+	return uint64_t(((unsigned __int128)a * b + bias) / c);
+#else
+	uint64_t p0 = (a & 0xffffffff) * (b & 0xffffffff);
+	uint64_t p1 = (a & 0xffffffff) * (b >> 32);
+	uint64_t p2 = (a >> 32) * (b & 0xffffffff);
+	uint64_t p3 = (a >> 32) * (b >> 32);
+	uint64_t mid = (p0 >> 32) + (p1 & 0xffffffff) + (p2 & 0xffffffff);
+	uint64_t lo = (p0 & 0xffffffff) | (mid << 32);
+	uint64_t hi = p3 + (p1 >> 32) + (p2 >> 32) + (mid >> 32);
+
+	lo += bias;
+	if (lo < bias) hi++;
+
+	uint64_t q = 0, r = hi;
+	for (int i = 63; i >= 0; i--)
+	{
+		bool carry = r >> 63;
+		r = (r << 1) | ((lo >> i) & 1);
+		q <<= 1;
+		if (carry || r >= c)
+		{
+			r -= c;
+			q |= 1;
+		}
+	}
+	return q;
+#endif
+}
+
+static int64_t fx_mul_div(int64_t a, int64_t b, int64_t c)
+{
+	// a * b / c rounded to nearest, halves away from zero (as round_near)
+	if (c == 0) return FX_NONE;
+	bool negative = ((a < 0) != (b < 0)) != (c < 0);
+	uint64_t ua = a < 0? -uint64_t(a) : a, ub = b < 0? -uint64_t(b) : b, uc = c < 0? -uint64_t(c) : c;
+	uint64_t q = mul_div_u64(ua, ub, uc, uc / 2);
+	return negative? -int64_t(q) : int64_t(q);
+}
+
+static int64_t fx_mul_div_trunc(int64_t a, int64_t b, int64_t c)
+{
+	// a * b / c truncated towards zero (as an int cast)
+	if (c == 0) return FX_NONE;
+	bool negative = ((a < 0) != (b < 0)) != (c < 0);
+	uint64_t ua = a < 0? -uint64_t(a) : a, ub = b < 0? -uint64_t(b) : b, uc = c < 0? -uint64_t(c) : c;
+	uint64_t q = mul_div_u64(ua, ub, uc, 0);
+	return negative? -int64_t(q) : int64_t(q);
+}
+
+static inline int64_t fx_div(int64_t a, int64_t b) { return fx_mul_div(a, 1, b); }
+
+//============================================================
+//  fx_floor, fx_ceil
+//============================================================
+
+static inline int64_t fx_floor(int64_t v) { return v >= 0? v / FX_ONE : -((-v + FX_ONE - 1) / FX_ONE); }
+static inline int64_t fx_ceil(int64_t v) { return v >= 0? (v + FX_ONE - 1) / FX_ONE : -(-v / FX_ONE); }
+
+//============================================================
+//  fx_round_near_odd, fx_round_near_even
+//============================================================
+
+static int fx_round_near_odd(int64_t v)
+{
+	return int(fx_ceil(v)) % 2 == 0? fx_floor(v) : fx_ceil(v);
+}
+
+static int fx_round_near_even(int64_t v)
+{
+	return int(fx_ceil(v)) % 2 == 1? fx_floor(v) : fx_ceil(v);
+}
+
+//============================================================
+//  fx_from_double
+//============================================================
+
+static inline int64_t fx_from_double(double value, double scale)
+{
+	return llround(value * scale);
+}
+
+static inline double fx_to_double(int64_t value)
+{
+	return double(value) / FX_ONE;
+}
+
+//============================================================
+//  fx_range_from
+//============================================================
+
+static void fx_range_from(fx_range *r, const monitor_range *range)
+{
+	// Vertical values come in seconds, horizontal ones in µs
+	r->hfreq_min = fx_from_double(range->hfreq_min, 1e6);
+	r->hfreq_max = fx_from_double(range->hfreq_max, 1e6);
+	r->vfreq_min = fx_from_double(range->vfreq_min, 1e6);
+	r->vfreq_max = fx_from_double(range->vfreq_max, 1e6);
+	r->hfront_porch = fx_from_double(range->hfront_porch, 1e6);
+	r->hsync_pulse = fx_from_double(range->hsync_pulse, 1e6);
+	r->hback_porch = fx_from_double(range->hback_porch, 1e6);
+	r->vfront_porch = fx_from_double(range->vfront_porch, 1e12);
+	r->vsync_pulse = fx_from_double(range->vsync_pulse, 1e12);
+	r->vertical_blank = fx_from_double(range->vertical_blank, 1e12);
+}
+
+//============================================================
+//  fx_scale_into_range
+//============================================================
+
+static int fx_scale_into_range(int64_t value, int64_t lower_limit, int64_t higher_limit)
+{
+	// Smallest scale that reaches the lower limit
+	int64_t scale = 1;
+	if (value > 0 && value < lower_limit)
+		scale = (lower_limit + value - 1) / value;
+
+	return value * scale <= higher_limit? int(scale) : 0;
+}
+
+//============================================================
+//  fx_scale_into_aspect
+//============================================================
+
+static int fx_scale_into_aspect(int source_res, int tot_res, bool rotation, int64_t aspect, int64_t *best_diff)
+{
+	// As scale_into_aspect, with the CRT aspect as 4/3 (3/4 rotated) and the monitor's in
+	// millionths. All scales share the denominator, so their diffs compare exactly. Diffs
+	// within the monitor aspect's rounding count as 0, an exact match as the double engine
+	// sees it. Returns the diff in millionths of a percent
+	int64_t crt_num = rotation? 3 : 4, crt_den = rotation? 4 : 3;
+	int64_t den = int64_t(tot_res) * crt_num * FX_ONE;
+	int64_t best = 0;
+	int scale = 1, best_scale = 1;
+
+	while (source_res * scale <= tot_res)
+	{
+		int64_t diff = llabs(den - aspect * source_res * scale * crt_den);
+		if (diff * 2 <= int64_t(source_res) * scale * crt_den)
+			diff = 0;
+
+		if (diff < best || best == 0)
+		{
+			best = diff;
+			best_scale = scale;
+		}
+		scale++;
+	}
+
+	*best_diff = den > 0? fx_mul_div(best, 100 * FX_ONE, den) : 0;
+	return best_scale;
+}
+
+//============================================================
+//  fx_first_multiple_reaching
+//============================================================
+
+static inline int64_t fx_first_multiple_reaching(int64_t value, int64_t limit, int64_t from)
+{
+	// Smallest n >= from with value * n >= limit (value > 0)
+	int64_t n = limit > 0? (limit + value - 1) / value : from;
+	return max(n, from);
+}
+
+//============================================================
+//  fx_borders
+//============================================================
+
+static int64_t fx_borders(const monitor_range *range, const fx_range *r, int yres, int interlace)
+{
+	// Top border in ps for multi-standard consumer TVs, (lines_max - yres / interlace) / hfreq_min / 2
+	int64_t half_lines = 2 * int64_t(range->progressive_lines_max) - int64_t(yres) * 2 / interlace;
+	return fx_mul_div(half_lines, FX_LINES, 4 * r->hfreq_min);
+}
+
+//============================================================
+//  fx_max_vfreq_for_yres
+//============================================================
+
+static int64_t fx_max_vfreq_for_yres(int yres, const fx_range *r, int64_t borders, int scan2)
+{
+	// scan2 is twice the scan factor (1 doublescan, 2 progressive, 4 interlaced), line counts are
+	// kept in half lines so every value stays exact
+	int64_t half_lines = int64_t(yres) * 4 / scan2 + 2 * fx_mul_div(r->hfreq_max, r->vertical_blank + borders, FX_LINES);
+	if (half_lines <= 0)
+		return FX_NONE;
+
+	return fx_div(r->hfreq_max * 2, half_lines);
+}
+
+//============================================================
+//  fx_total_lines_for_yres
+//============================================================
+
+static int fx_total_lines_for_yres(int yres, int64_t vfreq, const fx_range *r, int64_t borders, int scan2)
+{
+	// Share of the frame taken by the blanking, in millionths
+	int64_t blank = r->vertical_blank + borders;
+	int64_t share = fx_mul_div(vfreq, blank, FX_ONE * FX_ONE);
+	int64_t blank_lines = fx_div(fx_mul_div(int64_t(yres) * share, 2 * FX_ONE, scan2 * max(FX_ONE - share, 1LL)), FX_ONE);
+
+	int64_t vvt = max((int64_t(yres) * 4 / scan2 + 2 * blank_lines) / 2, 1LL);
+	if (!(vfreq > 0))
+		return int(vvt);
+
+	// Add lines until hfreq_min is reached, without letting the next line go over hfreq_max
+	int64_t vvt_min = fx_first_multiple_reaching(vfreq, r->hfreq_min, vvt);
+	int64_t vvt_max = fx_first_multiple_reaching(vfreq, r->hfreq_max, vvt + 1) - 1;
+	return int(min(vvt_min, vvt_max));
+}
+
+//============================================================
+//  fx_stretch_into_range
+//============================================================
+
+static int fx_stretch_into_range(int64_t vfreq, const monitor_range *range, const fx_range *r, int64_t borders, bool interlace_allowed, int *interlace)
+{
+	int yres, lower_limit;
+
+	if (range->interlaced_lines_min && interlace_allowed)
+	{
+		yres = range->interlaced_lines_max;
+		lower_limit = range->interlaced_lines_min;
+		*interlace = 2;
+	}
+	else
+	{
+		yres = range->progressive_lines_max;
+		lower_limit = range->progressive_lines_min;
+	}
+
+	int lo = 0, hi = yres > lower_limit? (yres - lower_limit + 7) / 8 : 0;
+	while (lo < hi)
+	{
+		int mid = lo + (hi - lo) / 2;
+		int y = yres - mid * 8;
+
+		if (y <= lower_limit || fx_max_vfreq_for_yres(y, r, borders, *interlace * 2) >= vfreq)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	return yres - lo * 8;
+}
+
+//============================================================
+//  fx_line_param_grows
+//============================================================
+
+static inline bool fx_line_param_grows(int64_t chars, int64_t char_time, int64_t target, int64_t target_min)
+{
+	return chars * char_time < target_min ||
+		llabs((chars + 1) * char_time - target) < llabs(chars * char_time - target);
+}
+
+//============================================================
+//  fx_line_param_fit
+//============================================================
+
+static inline int fx_line_param_fit(int chars, int64_t char_time, int64_t target, int64_t target_min)
+{
+	int64_t estimate = max((target_min + char_time - 1) / char_time, (2 * target + char_time) / (2 * char_time));
+	int fit = estimate > chars? int(estimate) : chars;
+
+	while (fit > chars && !fx_line_param_grows(fit - 1, char_time, target, target_min))
+		fit--;
+
+	while (fx_line_param_grows(fit, char_time, target, target_min))
+		fit++;
+
+	return fit;
+}
+
+//============================================================
+//  fx_get_line_params
+//============================================================
+
+static void fx_get_line_params(modeline *mode, const fx_range *r, int64_t hfreq, int char_size)
+{
+	int hh, hs, he, ht;
+	int new_hs, new_he, new_ht;
+
+	int64_t hfront_porch_min = fx_div(r->hfront_porch * 9, 10);
+	int64_t hsync_pulse_min  = fx_div(r->hsync_pulse * 9, 10);
+	int64_t hback_porch_min  = fx_div(r->hback_porch * 9, 10);
+
+	int64_t line_time = fx_div(FX_LINES, hfreq);
+
+	hh = mode->hactive / char_size;
+	hs = he = ht = 1;
+
+	for (;;)
+	{
+		int64_t char_time = max(fx_div(line_time, hh + hs + he + ht), 1LL);
+
+		new_hs = fx_line_param_fit(hs, char_time, r->hfront_porch, hfront_porch_min);
+		new_he = fx_line_param_fit(he, char_time, r->hsync_pulse, hsync_pulse_min);
+		new_ht = fx_line_param_fit(ht, char_time, r->hback_porch, hback_porch_min);
+
+		if (new_hs == hs && new_he == he && new_ht == ht)
+			break;
+
+		hs = new_hs;
+		he = new_he;
+		ht = new_ht;
+	}
+
+	mode->hbegin = (hh + hs) * char_size;
+	mode->hend   = (hh + hs + he) * char_size;
+	mode->htotal = (hh + hs + he + ht) * char_size;
+}
+
+//============================================================
+//  fx_quantize_pclock
+//============================================================
+
+static int64_t fx_quantize_pclock(uint64_t *pclock, int htotal, const fx_range *r, uint64_t quantum)
+{
+	// As modeline_quantize_pclock, returns the line frequency of the new clock
+	uint64_t low = *pclock / quantum * quantum;
+	uint64_t high = low + quantum;
+	uint64_t best = *pclock - low < high - *pclock? low : high;
+	uint64_t other = best == low? high : low;
+
+	int64_t best_hfreq = fx_mul_div(best, FX_ONE, htotal);
+	int64_t other_hfreq = fx_mul_div(other, FX_ONE, htotal);
+	bool best_in = best && best_hfreq >= r->hfreq_min && best_hfreq <= r->hfreq_max;
+	bool other_in = other && other_hfreq >= r->hfreq_min && other_hfreq <= r->hfreq_max;
+
+	if (!best || (!best_in && other_in))
+	{
+		best = other;
+		best_hfreq = other_hfreq;
+	}
+
+	*pclock = best;
+	return best_hfreq;
+}
+
+//============================================================
+//  modeline_generate_fixed
+//============================================================
+
+modeline modeline_generate_fixed(const modeline *s_mode, const modeline *t_mode, const monitor_range *range, const generator_settings *cs)
+{
+	modeline mode = *t_mode;
+	const modeline *src = s_mode == t_mode? &mode : s_mode;
+
+	fx_range r;
+	fx_range_from(&r, range);
+
+	int64_t vfreq = fx_from_double(mode.vfreq, 1e6);
+	int64_t aspect = fx_from_double(cs->monitor_aspect, 1e6);
+	int64_t vfreq_real = 0;
+	int64_t v_diff = 0;
+	int64_t borders = 0;
+	int interlace = 1;
+	bool doublescan = false;
+	int scan2 = 2;
+	int x_scale = 0;
+	int y_scale = 0;
+	int v_scale = 0;
+	int64_t x_diff = 0;
+	double y_diff = 0;
+	double y_ratio = 0;
+	double x_ratio = 0;
+	mode.result.weight = 0;
+
+	// ≈≈≈ Vertical refresh ≈≈≈
+	v_scale = fx_scale_into_range(vfreq, r.vfreq_min, r.vfreq_max);
+
+	if (!v_scale && (mode.type & V_FREQ_EDITABLE))
+	{
+		vfreq = vfreq < r.vfreq_min? r.vfreq_min : r.vfreq_max;
+		mode.vfreq = fx_to_double(vfreq);
+		v_scale = 1;
+	}
+	else if (v_scale != 1 && !(mode.type & V_FREQ_EDITABLE))
+	{
+		mode.result.weight |= R_OUT_OF_RANGE;
+		return mode;
+	}
+
+	// ≈≈≈ Vertical resolution ≈≈≈
+	if (range->progressive_lines_min && (!mode.interlace || (mode.type & SCAN_EDITABLE)))
+		y_scale = scale_into_range(mode.vactive, range->progressive_lines_min, range->progressive_lines_max);
+
+	if (!y_scale && range->interlaced_lines_min && cs->interlace && (mode.interlace || (mode.type & SCAN_EDITABLE)))
+	{
+		y_scale = scale_into_range(mode.vactive, range->interlaced_lines_min, range->interlaced_lines_max);
+		interlace = 2;
+	}
+
+	if (y_scale == 1 || (y_scale > 1 && (mode.type & Y_RES_EDITABLE)))
+	{
+		if (cs->doublescan && y_scale % 2 == 0)
+		{
+			y_scale /= 2;
+			doublescan = true;
+		}
+		scan2 = interlace * (doublescan? 1 : 2);
+
+		if (cs->v_shift_correct)
+			borders = fx_borders(range, &r, mode.vactive * y_scale, interlace);
+
+		vfreq_real = min(vfreq * v_scale, fx_max_vfreq_for_yres(mode.vactive * y_scale, &r, borders, scan2));
+		if (vfreq_real != vfreq * v_scale && !(mode.type & V_FREQ_EDITABLE))
+		{
+			mode.result.weight |= R_OUT_OF_RANGE;
+			return mode;
+		}
+
+		// Lines and their remainder instead of ratio and diff, the diff is y_rest / y_lines * 100
+		int y_lines = mode.vactive * y_scale;
+		int y_whole = y_lines / src->vactive;
+		int y_source_scaled = src->vactive * y_whole;
+
+		if (!y_source_scaled)
+			mode.result.weight |= R_RES_STRETCH;
+
+		else
+		{
+			int y_rest;
+			if (mode.type & V_FREQ_EDITABLE && range->progressive_lines_max - range->progressive_lines_min > 0)
+			{
+				int tot_yres = fx_total_lines_for_yres(y_lines, vfreq_real, &r, borders, scan2);
+				int tot_source = fx_total_lines_for_yres(y_source_scaled, vfreq * v_scale, &r, borders, scan2);
+				y_rest = tot_yres > tot_source? tot_yres % tot_source : 0;
+
+				int y_min = interlace == 2?range->interlaced_lines_min:range->progressive_lines_min;
+				int y_source_lines = doublescan? y_source_scaled * 2 : y_source_scaled;
+				y_rest += (y_min >= y_source_lines)? y_min % y_source_lines:0;
+				y_lines = tot_yres;
+			}
+			else
+				y_rest = y_lines % y_source_scaled;
+
+			y_diff = double(y_rest) * 100 / y_lines;
+			y_scale = y_whole;
+
+			// Ratio from 1 up to 16, diff under 10%
+			if (!(y_whole >= 1 && y_whole < 16 && y_rest * 10 < y_lines))
+				mode.result.weight |= R_RES_STRETCH;
+		}
+	}
+
+	else if (mode.type & Y_RES_EDITABLE)
+		mode.result.weight |= R_RES_STRETCH;
+
+	else
+	{
+		mode.result.weight |= R_OUT_OF_RANGE;
+		return mode;
+	}
+
+	// ≈≈≈ Horizontal resolution ≈≈≈
+	if (!(mode.result.weight & R_RES_STRETCH))
+	{
+		if (mode.type & Y_RES_EDITABLE) mode.vactive *= y_scale;
+
+		if (mode.type & X_RES_EDITABLE)
+		{
+			// Widened by the monitor to CRT aspect ratio when it's over 1
+			x_scale = y_scale;
+			int64_t width = int64_t(mode.hactive) * x_scale;
+			int64_t crt_num = cs->rotation? 3 : 4, crt_den = cs->rotation? 4 : 3;
+			if (aspect * crt_den > crt_num * FX_ONE)
+				width = fx_mul_div_trunc(width, aspect * crt_den, crt_num * FX_ONE);
+
+			mode.hactive = normalize(int(width), 8);
+		}
+
+		else
+		{
+			x_scale = mode.hactive / src->hactive;
+			if (x_scale)
+			{
+				x_scale = fx_scale_into_aspect(src->hactive, mode.hactive, cs->rotation, aspect, &x_diff);
+				if (x_diff > 15 * FX_ONE && mode.hactive < cs->super_width)
+						mode.result.weight |= R_RES_STRETCH;
+			}
+			else
+				mode.result.weight |= R_RES_STRETCH;
+		}
+	}
+
+	if (mode.result.weight & R_RES_STRETCH)
+	{
+		if (mode.type & Y_RES_EDITABLE)
+		{
+			mode.vactive = fx_stretch_into_range(vfreq * v_scale, range, &r, borders, cs->interlace, &interlace);
+			vfreq_real = min(vfreq * v_scale, fx_max_vfreq_for_yres(mode.vactive, &r, borders, interlace * 2));
+		}
+
+		if (mode.type & X_RES_EDITABLE)
+			mode.hactive = max(mode.hactive, normalize(mode.vactive * 4 / 3, 8));
+
+		x_scale = max(1, fx_scale_into_aspect(src->hactive, mode.hactive, cs->rotation, aspect, &x_diff));
+		y_scale = max(1, mode.vactive / src->vactive);
+
+		scan2 = interlace * 2;
+		doublescan = false;
+	}
+
+	// When regenerating a mode from itself its refresh may have been moved into range above
+	int64_t src_vfreq = src == &mode? vfreq : fx_from_double(src->vfreq, 1e6);
+
+	x_ratio = double(mode.hactive) / src->hactive;
+	y_ratio = double(mode.vactive) / src->vactive;
+	v_scale = src_vfreq > 0? max(int(fx_div(vfreq_real, src_vfreq)), 1) : 1;
+	v_diff = fx_div(vfreq_real, v_scale) - src_vfreq;
+	if (llabs(v_diff) > fx_from_double(cs->refresh_tolerance, 1e6))
+		mode.result.weight |= R_V_FREQ_OFF;
+
+	// ≈≈≈ Modeline generation ≈≈≈
+	if (mode.type & V_FREQ_EDITABLE)
+	{
+		int half_line = !cs->interlace_force_even && interlace == 2? 1 : 0;
+
+		vfreq = vfreq_real;
+
+		// Total vertical lines and horizontal frequency, in half lines
+		int64_t vvt_ini = 2 * int64_t(fx_total_lines_for_yres(mode.vactive, vfreq, &r, borders, scan2)) + half_line;
+		int64_t hfreq = fx_div(vfreq * vvt_ini, 2);
+
+		horizontal_values:
+
+		fx_get_line_params(&mode, &r, hfreq, cs->pixel_precision? 1 : 8);
+		mode.htotal = timing_align_htotal(mode.htotal, &cs->constraints);
+
+		// Pixel clock in Hz, truncated
+		mode.pclock = uint64_t(mode.htotal) * hfreq / FX_ONE;
+		if (mode.pclock <= cs->pclock_min || mode.pclock < cs->constraints.pclock_min)
+		{
+			if (mode.type & X_RES_EDITABLE)
+			{
+				x_scale *= 2;
+				mode.hactive *= 2;
+				goto horizontal_values;
+			}
+			else
+			{
+				mode.result.weight |= R_OUT_OF_RANGE;
+				return mode;
+			}
+		}
+
+		// Vertical blanking, margin and front porch in millionths of a line
+		mode.vtotal = vvt_ini * scan2 / 4;
+		int64_t vblank_lines = 2 * fx_mul_div_trunc(hfreq, r.vertical_blank + borders, FX_LINES) + half_line;
+		int64_t margin = (4 * int64_t(mode.vtotal - mode.vactive) - vblank_lines * scan2) * (FX_ONE / 4 / (cs->v_shift_correct? 1 : 2));
+		int64_t v_front_porch = margin + fx_mul_div(hfreq * scan2, r.vfront_porch, 2 * FX_ONE * FX_ONE);
+
+		// The double engine always rounds to odd or even here, as its interlace factor is never 0
+		int front_porch_lines = cs->interlace_force_even? fx_round_near_even(v_front_porch) : fx_round_near_odd(v_front_porch);
+
+		mode.vbegin = mode.vactive + max(front_porch_lines, 1);
+		mode.vend = mode.vbegin + max(int(fx_mul_div(hfreq * scan2, r.vsync_pulse, 2 * FX_LINES)), 1);
+
+		// Pixel clock as the backend will store it, and the rates it produces
+		if (cs->constraints.pclock_quantum > 1 && mode.pclock)
+			hfreq = fx_quantize_pclock(&mode.pclock, mode.htotal, &r, cs->constraints.pclock_quantum);
+
+		// Final refresh
+		vfreq = mode.vtotal > 0? fx_div(hfreq * scan2, 2 * int64_t(mode.vtotal)) : 0;
+
+		mode.hfreq = fx_to_double(hfreq);
+		mode.vfreq = fx_to_double(vfreq);
+		mode.hsync = range->hsync_polarity;
+		mode.vsync = range->vsync_polarity;
+		mode.interlace = interlace == 2?1:0;
+		mode.doublescan = doublescan?1:0;
+
+		if (!timing_within_limits(&mode, &cs->constraints))
+		{
+			mode.result.weight |= R_OUT_OF_RANGE;
+			return mode;
+		}
+	}
+
+	mode.result.scan_penalty = (src->interlace != mode.interlace? 1:0) + (src->doublescan != mode.doublescan? 1:0);
+	mode.result.x_scale = x_scale;
+	mode.result.y_scale = y_scale;
+	mode.result.v_scale = v_scale;
+	mode.result.x_diff = fx_to_double(x_diff);
+	mode.result.y_diff = y_diff;
+	mode.result.v_diff = fx_to_double(v_diff);
+	mode.result.x_ratio = x_ratio;
+	mode.result.y_ratio = y_ratio;
+	mode.result.v_ratio = 0;
+
+	// Refresh error in millionths of a ppm
+	int64_t v_target = src_vfreq * v_scale;
+	mode.result.v_ppm = v_target > 0? fx_mul_div(fx_from_double(mode.vfreq, 1e6) - v_target, FX_ONE * FX_ONE, v_target) / 1e6 : 0;
+
+	return mode;
+}
+
+//============================================================
+//  modeline_weight_bound_fixed
+//============================================================
+
+int modeline_weight_bound_fixed(const modeline *s_mode, const modeline *t_mode, const monitor_range *range, const generator_settings *cs)
+{
+	// Early steps of modeline_generate_fixed, see modeline_weight_bound
+	int weight = 0;
+	int interlace = 1;
+	bool doublescan = false;
+	int y_scale = 0;
+
+	fx_range r;
+	fx_range_from(&r, range);
+
+	int64_t vfreq = fx_from_double(t_mode->vfreq, 1e6);
+	int v_scale = fx_scale_into_range(vfreq, r.vfreq_min, r.vfreq_max);
+
+	if (!v_scale && (t_mode->type & V_FREQ_EDITABLE))
+		v_scale = 1;
+
+	else if (v_scale != 1 && !(t_mode->type & V_FREQ_EDITABLE))
+		return R_OUT_OF_RANGE;
+
+	if (range->progressive_lines_min && (!t_mode->interlace || (t_mode->type & SCAN_EDITABLE)))
+		y_scale = scale_into_range(t_mode->vactive, range->progressive_lines_min, range->progressive_lines_max);
+
+	if (!y_scale && range->interlaced_lines_min && cs->interlace && (t_mode->interlace || (t_mode->type & SCAN_EDITABLE)))
+	{
+		y_scale = scale_into_range(t_mode->vactive, range->interlaced_lines_min, range->interlaced_lines_max);
+		interlace = 2;
+	}
+
+	if (y_scale == 1 || (y_scale > 1 && (t_mode->type & Y_RES_EDITABLE)))
+	{
+		if (cs->doublescan && y_scale % 2 == 0)
+		{
+			y_scale /= 2;
+			doublescan = true;
+		}
+
+		if (!(t_mode->type & V_FREQ_EDITABLE))
+		{
+			int64_t borders = cs->v_shift_correct? fx_borders(range, &r, t_mode->vactive * y_scale, interlace) : 0;
+			int64_t vfreq_real = min(vfreq * v_scale, fx_max_vfreq_for_yres(t_mode->vactive * y_scale, &r, borders, interlace * (doublescan? 1 : 2)));
+			if (vfreq_real != vfreq * v_scale)
+				return R_OUT_OF_RANGE;
+
+			if (!(t_mode->type & Y_RES_EDITABLE))
+			{
+				int64_t src_vfreq = fx_from_double(s_mode->vfreq, 1e6);
+				int v_scale_source = src_vfreq > 0? max(int(fx_div(vfreq_real, src_vfreq)), 1) : 1;
+				if (llabs(fx_div(vfreq_real, v_scale_source) - src_vfreq) > fx_from_double(cs->refresh_tolerance, 1e6))
+					weight |= R_V_FREQ_OFF;
+			}
+		}
+
+		double y_ratio = double(t_mode->vactive) * y_scale / s_mode->vactive;
+		int y_source_scaled = s_mode->vactive * floor(y_ratio);
+		if (!y_source_scaled)
+			weight |= R_RES_STRETCH;
+	}
+
+	else if (t_mode->type & Y_RES_EDITABLE)
+		weight |= R_RES_STRETCH;
+
+	else
+		return R_OUT_OF_RANGE;
+
+	return weight;
+}
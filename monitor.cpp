@@ -33,7 +33,7 @@
 
 int monitor_fill_range(monitor_range *range, const char *specs_line)
 {
-	monitor_range new_range;
+	monitor_range new_range = {};
 
 	if (strcmp(specs_line, "auto")) {
 		int e = sscanf(specs_line, "%lf-%lf,%lf-%lf,%lf,%lf,%lf,%lf,%lf,%lf,%d,%d,%d,%d,%d,%d",
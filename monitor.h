@@ -47,6 +47,7 @@ typedef struct monitor_range
 	int    interlaced_lines_min;
 	int    interlaced_lines_max;
 	double vertical_blank;
+	const struct range_lut *lut;
 } monitor_range;
 
 //============================================================
@@ -16,6 +16,7 @@
 #include <string.h>
 #include <algorithm>
 #include "switchres.h"
+#include "work_pool.h"
 #include "log.h"
 
 using namespace std;
@@ -86,6 +87,7 @@ switchres_manager::switchres_manager()
 	// Set Switchres default config options
 	set_monitor("generic_15");
 	set_modeline("auto");
+	set_mode_cache("none");
 	set_lcd_range("auto");
 	for (int i = 0; i++ < MAX_RANGES;) set_crt_range(i, "auto");
 
@@ -95,6 +97,7 @@ switchres_manager::switchres_manager()
 	set_lock_unsupported_modes(true);
 	set_lock_system_modes(true);
 	set_refresh_dont_care(false);
+	set_mode_pool(0);
 
 	// Set modeline generator default options
 	set_interlace(true);
@@ -110,6 +113,8 @@ switchres_manager::switchres_manager()
 	set_v_shift_correct(0);
 	set_pixel_precision(1);
 	set_interlace_force_even(0);
+	set_timing_engine(TIMING_ENGINE_DOUBLE);
+	set_refresh_ppm(0);
 
 	// Create our display manager
 	m_display_factory = new display_manager();
@@ -131,6 +136,9 @@ switchres_manager::~switchres_manager()
 
 	for (auto &display : displays)
 		delete display;
+
+	// Stop the search threads before the library goes away
+	work_pool::shutdown();
 };
 
 //============================================================
@@ -248,6 +256,9 @@ bool switchres_manager::parse_config(const char *file_name)
 				case s2i("modeline"):
 					set_modeline(value.c_str());
 					break;
+				case s2i("mode_cache"):
+					set_mode_cache(value.c_str());
+					break;
 				case s2i("user_mode"):
 				{
 					modeline user_mode = {};
@@ -285,6 +296,9 @@ bool switchres_manager::parse_config(const char *file_name)
 				case s2i("keep_changes"):
 					set_keep_changes(atoi(value.c_str()));
 					break;
+				case s2i("mode_pool"):
+					set_mode_pool(atoi(value.c_str()));
+					break;
 
 				// Modeline generation options
 				case s2i("interlace"):
@@ -350,6 +364,18 @@ bool switchres_manager::parse_config(const char *file_name)
 					set_interlace_force_even(atoi(value.c_str()));
 					break;
 
+				case s2i("timing_engine"):
+					set_timing_engine(value.c_str());
+					break;
+
+				case s2i("refresh_ppm"):
+				{
+					double refresh_ppm = 0.0f;
+					sscanf(value.c_str(), "%lf", &refresh_ppm);
+					set_refresh_ppm(refresh_ppm);
+					break;
+				}
+
 				// Custom video backend options
 				case s2i("screen_compositing"):
 					set_screen_compositing(atoi(value.c_str()));
@@ -58,6 +58,7 @@ public:
 	// setters (display manager)
 	void set_monitor(const char *preset) { strncpy(ds.monitor, preset, sizeof(ds.monitor)-1); }
 	void set_modeline(const char *modeline) { strncpy(ds.user_modeline, modeline, sizeof(ds.user_modeline)-1); }
+	void set_mode_cache(const char *file_name) { strncpy(ds.mode_cache, file_name, sizeof(ds.mode_cache)-1); }
 	void set_user_mode(modeline *user_mode) { ds.user_mode = *user_mode;}
 	void set_crt_range(int i, const char *range) { strncpy(ds.crt_range[i], range, sizeof(ds.crt_range[i])-1); }
 	void set_lcd_range(const char *range) { strncpy(ds.lcd_range, range, sizeof(ds.lcd_range)-1); }
@@ -68,6 +69,7 @@ public:
 	void set_lock_system_modes(bool value) { ds.lock_system_modes = value; }
 	void set_refresh_dont_care(bool value) { ds.refresh_dont_care = value; }
 	void set_keep_changes(bool value) { ds.keep_changes = value; }
+	void set_mode_pool(int value) { ds.mode_pool = value; }
 
 	// setters (modeline generator)
 	void set_interlace(bool value) { ds.gs.interlace = value; }
@@ -84,6 +86,9 @@ public:
 	void set_v_shift_correct(int value) { ds.gs.v_shift_correct = value; }
 	void set_pixel_precision(int value) { ds.gs.pixel_precision = value; }
 	void set_interlace_force_even(int value) { ds.gs.interlace_force_even = value; }
+	void set_timing_engine(int value) { ds.gs.timing_engine = value; }
+	void set_timing_engine(const char *engine) { set_timing_engine(strcmp(engine, "fixed")? TIMING_ENGINE_DOUBLE : TIMING_ENGINE_FIXED); }
+	void set_refresh_ppm(double value) { ds.gs.refresh_ppm = value; }
 
 	// setters (custom_video backend)
 	void set_screen_compositing(bool value) { ds.vs.screen_compositing = value; }
@@ -22,10 +22,13 @@ using namespace std;
 
 int show_version();
 int show_usage();
+int build_mode_cache(display_manager *display, const char *list_file);
 
 enum
  {
-	OPT_MODELINE = 128
+	OPT_MODELINE = 128,
+	OPT_MODE_CACHE,
+	OPT_CACHE_BUILD
  };
 
 //============================================================
@@ -57,10 +60,13 @@ int main(int argc, char **argv)
 	bool user_ini_flag = false;
 	bool keep_changes_flag = false;
 	bool geometry_flag = false;
+	bool cache_build_flag = false;
+	bool verbose_flag = false;
 	int status_code = 0;
 
 	string ini_file;
 	string launch_command;
+	string cache_list;
 
 	while (1)
 	{
@@ -83,6 +89,8 @@ int main(int argc, char **argv)
 			{"keep",        no_argument,       0, 'k'},
 			{"geometry",    required_argument, 0, 'g'},
 			{"modeline",    required_argument, 0, OPT_MODELINE},
+			{"mode-cache",  required_argument, 0, OPT_MODE_CACHE},
+			{"cache-build", required_argument, 0, OPT_CACHE_BUILD},
 			{0, 0, 0, 0}
 		};
 
@@ -104,7 +112,17 @@ int main(int argc, char **argv)
 				switchres.set_modeline(optarg);
 				break;
 
+			case OPT_MODE_CACHE:
+				switchres.set_mode_cache(optarg);
+				break;
+
+			case OPT_CACHE_BUILD:
+				cache_build_flag = true;
+				cache_list = optarg;
+				break;
+
 			case 'v':
+				verbose_flag = true;
 				switchres.set_log_level(3);
 				switchres.set_log_error_fn((void*)printf);
 				switchres.set_log_info_fn((void*)printf);
@@ -185,6 +203,20 @@ int main(int argc, char **argv)
 	if (help_flag)
 		goto usage;
 
+	if (cache_build_flag)
+	{
+		if (user_ini_flag)
+			switchres.parse_config(ini_file.c_str());
+
+		switchres.add_display();
+		if (!calculate_flag)
+			switchres.display()->init();
+		else
+			switchres.display()->open_mode_cache();
+
+		return build_mode_cache(switchres.display(), cache_list.c_str());
+	}
+
 	// Get user video mode information from command line
 	if ((argc - optind) < 3)
 	{
@@ -219,6 +251,10 @@ int main(int argc, char **argv)
 
 	switchres.add_display();
 
+	// Candidate details are collected during the search and printed afterwards
+	if (verbose_flag)
+		switchres.display()->set_mode_trace(true);
+
 	if (force_flag)
 		switchres.display()->set_user_mode(&user_mode);
 
@@ -227,12 +263,19 @@ int main(int argc, char **argv)
 		for (auto &display : switchres.displays)
 			display->init();
 	}
+	else
+	{
+		// No backend to wait for, the cache goes by our settings alone
+		for (auto &display : switchres.displays)
+			display->open_mode_cache();
+	}
 
 	if (resolution_flag)
 	{
 		for (auto &display : switchres.displays)
 		{
 			modeline *mode = display->get_mode(width, height, refresh, interlaced_flag);
+			if (verbose_flag) display->print_mode_trace();
 			if (mode) display->flush_modes();
 
 			if (mode && geometry_flag)
@@ -293,6 +336,42 @@ usage:
 	return 0;
 }
 
+//============================================================
+//  build_mode_cache
+//============================================================
+
+int build_mode_cache(display_manager *display, const char *list_file)
+{
+	// List format is one mode per line: <width> <height> <refresh>[i]
+	FILE *file = fopen(list_file, "r");
+	if (!file)
+	{
+		log_error("Error: can't open %s\n", list_file);
+		return 1;
+	}
+
+	vector<mode_request> requests;
+	char line[256];
+
+	while (fgets(line, sizeof(line), file))
+	{
+		mode_request request = {};
+		char scan_mode = 0;
+
+		if (line[0] == '#' || sscanf(line, "%d %d %f%c", &request.width, &request.height, &request.refresh, &scan_mode) < 3)
+			continue;
+
+		request.interlace = (scan_mode == 'i');
+		if (request.width > 0 && request.height > 0 && request.refresh > 0.0f)
+			requests.push_back(request);
+	}
+	fclose(file);
+
+	log_info("Building mode cache for %d modes from %s\n", (int)requests.size(), list_file);
+	display->build_mode_cache(requests);
+	return 0;
+}
+
 //============================================================
 //  show_version
 //============================================================
@@ -337,6 +416,8 @@ int show_usage()
 		"  -k, --keep                        Keep changes on exit (warning: this disables cleanup)\n"
 		"  -g, --geometry <h_size>:<h_shift>:<v_shift>  Adjust geometry of generated modeline\n"
 		"  --modeline <\"pclk hdisp hsst hsend htot vdisp vsst vsend vtot flags\">  Force an XFree86 modeline\n"
+		"  --mode-cache <file>               Store calculated modes in <file> and reuse them on next runs\n"
+		"  --cache-build <list>              Fill the mode cache with the modes in <list> (<width> <height> <refresh>[i] per line) and exit\n"
 	};
 
 	log_info("%s", usage);
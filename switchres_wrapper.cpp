@@ -67,40 +67,37 @@ MODULE_API void sr_set_user_mode(int width, int height, int refresh) {
 }
 
 
+void modeline_to_sr_mode(modeline* mode, sr_mode* srm)
+{
+	srm->width = mode->hactive;
+	srm->height = mode->vactive;
+	srm->refresh = mode->vfreq;
+	srm->is_refresh_off = (mode->result.weight & R_V_FREQ_OFF ? 1 : 0);
+	srm->is_stretched = (mode->result.weight & R_RES_STRETCH ? 1 : 0);
+	srm->x_scale = mode->result.x_scale;
+	srm->y_scale = mode->result.y_scale;
+	srm->interlace = (mode->interlace ? 105 : 0);
+}
+
+
 void disp_best_mode_to_sr_mode(display_manager* disp, sr_mode* srm)
 {
-	srm->width = disp->best_mode()->hactive;
-	srm->height = disp->best_mode()->vactive;
-	srm->refresh = disp->v_freq();
-	srm->is_refresh_off = (disp->is_refresh_off() ? 1 : 0);
-	srm->is_stretched = (disp->is_stretched() ? 1 : 0);
-	srm->x_scale = disp->x_scale();
-	srm->y_scale = disp->y_scale();
-	srm->interlace = (disp->is_interlaced() ? 105 : 0);
+	modeline_to_sr_mode(disp->best_mode(), srm);
 }
 
 
 bool sr_refresh_display(display_manager *disp)
 {
-	if (disp->is_mode_updated())
+	if (!disp->is_mode_updated() && !disp->is_mode_new())
 	{
-		if (disp->update_mode(disp->best_mode()))
-		{
-			log_info("sr_refresh_display: mode was updated\n");
-			return true;
-		}
-	}
-	else if (disp->is_mode_new())
-	{
-		if (disp->add_mode(disp->best_mode()))
-		{
-			log_info("sr_refresh_display: mode was added\n");
-			return true;
-		}
+		log_info("sr_refresh_display: no refresh required\n");
+		return true;
 	}
-	else
+
+	// If the backend rejects the mode, the next best candidates are tried
+	if (disp->apply_best_mode())
 	{
-		log_info("sr_refresh_display: no refresh required\n");
+		log_info("sr_refresh_display: mode was applied (candidate %d)\n", disp->applied_rank());
 		return true;
 	}
 
@@ -123,9 +120,11 @@ MODULE_API unsigned char sr_add_mode(int width, int height, double refresh, unsi
 	if (disp->got_mode())
 	{
 		log_verbose("sr_add_mode: got mode %dx%d@%f type(%x)\n", disp->width(), disp->height(), disp->v_freq(), disp->best_mode()->type);
-		if (return_mode != nullptr) disp_best_mode_to_sr_mode(disp, return_mode);
 		if (sr_refresh_display(disp))
+		{
+			if (return_mode != nullptr) disp_best_mode_to_sr_mode(disp, return_mode);
 			return 1;
+		}
 	}
 
 	printf("sr_add_mode: error adding mode\n");
@@ -147,9 +146,9 @@ MODULE_API unsigned char sr_switch_to_mode(int width, int height, double refresh
 	if (disp->got_mode())
 	{
 		log_verbose("sr_switch_to_mode: got mode %dx%d@%f type(%x)\n", disp->width(), disp->height(), disp->v_freq(), disp->best_mode()->type);
-		if (return_mode != nullptr) disp_best_mode_to_sr_mode(disp, return_mode);
 		if (!sr_refresh_display(disp))
 			return 0;
+		if (return_mode != nullptr) disp_best_mode_to_sr_mode(disp, return_mode);
 	}
 
 	if (disp->is_switching_required())
@@ -171,6 +170,122 @@ MODULE_API unsigned char sr_switch_to_mode(int width, int height, double refresh
 }
 
 
+MODULE_API int sr_get_modes_batch(const sr_mode_request *requests, sr_mode *return_modes, int count) {
+
+	log_verbose("Inside sr_get_modes_batch(%d)\n", count);
+	if (count <= 0)
+		return 0;
+
+	if (requests == nullptr || return_modes == nullptr)
+	{
+		log_error("sr_get_modes_batch: error, no requests or modes passed\n");
+		return 0;
+	}
+
+	display_manager *disp = swr->display();
+	if (disp == nullptr)
+	{
+		log_error("sr_get_modes_batch: error, didn't get a display\n");
+		return 0;
+	}
+
+	std::vector<mode_request> mode_requests(count);
+	for (int i = 0; i < count; i++)
+		mode_requests[i] = { requests[i].width, requests[i].height, float(requests[i].refresh), requests[i].interlace > 0 };
+
+	std::vector<modeline> modes;
+	int modes_found = disp->get_modes(mode_requests, modes);
+
+	// Requests that couldn't be solved are returned zeroed
+	for (int i = 0; i < count; i++)
+	{
+		if (modes[i].result.weight & R_OUT_OF_RANGE)
+			return_modes[i] = {};
+		else
+			modeline_to_sr_mode(&modes[i], &return_modes[i]);
+	}
+
+	return modes_found;
+}
+
+
+MODULE_API int sr_get_top_modes(const sr_mode_request *request, sr_mode *return_modes, int count) {
+
+	log_verbose("Inside sr_get_top_modes(%d)\n", count);
+	if (count <= 0)
+		return 0;
+
+	if (request == nullptr || return_modes == nullptr)
+	{
+		log_error("sr_get_top_modes: error, no request or modes passed\n");
+		return 0;
+	}
+
+	display_manager *disp = swr->display();
+	if (disp == nullptr)
+	{
+		log_error("sr_get_top_modes: error, didn't get a display\n");
+		return 0;
+	}
+
+	mode_request mode = { request->width, request->height, float(request->refresh), request->interlace > 0 };
+
+	// Best mode first, as many as fit in return_modes
+	std::vector<modeline> modes;
+	int modes_found = disp->get_top_modes(mode, count, modes);
+
+	for (int i = 0; i < modes_found; i++)
+		modeline_to_sr_mode(&modes[i], &return_modes[i]);
+
+	return modes_found;
+}
+
+MODULE_API int sr_prewarm_modes(const sr_mode_request *requests, int count) {
+
+	log_verbose("Inside sr_prewarm_modes(%d)\n", count);
+	if (count <= 0)
+		return 0;
+
+	if (requests == nullptr)
+	{
+		log_error("sr_prewarm_modes: error, no requests passed\n");
+		return 0;
+	}
+
+	display_manager *disp = swr->display();
+	if (disp == nullptr)
+	{
+		log_error("sr_prewarm_modes: error, didn't get a display\n");
+		return 0;
+	}
+
+	// The modes are added to the driver now, so switching to them later doesn't add them
+	std::vector<mode_request> mode_requests(count);
+	for (int i = 0; i < count; i++)
+		mode_requests[i] = { requests[i].width, requests[i].height, float(requests[i].refresh), requests[i].interlace > 0 };
+
+	return disp->prewarm_modes(mode_requests);
+}
+
+MODULE_API double sr_get_refresh_ppm() {
+	display_manager *disp = swr->display();
+	if (disp == nullptr || !disp->got_mode())
+		return 0;
+
+	// Error of the refresh against the requested one, in parts per million
+	return disp->best_mode()->result.v_ppm;
+}
+
+MODULE_API int sr_get_fallback_rank() {
+	// 0 for the best mode, n for the nth next best when the backend rejected the others,
+	// -1 when no mode was applied, the backend rejected them all included
+	display_manager *disp = swr->display();
+	if (disp == nullptr || !disp->got_mode())
+		return -1;
+
+	return disp->applied_rank();
+}
+
 MODULE_API void sr_set_rotation (unsigned char r) {
 	if (r > 0)
 	{
@@ -217,6 +332,11 @@ MODULE_API srAPI srlib = {
 	sr_set_log_callback_error,
 	sr_set_log_callback_info,
 	sr_set_log_callback_debug,
+	sr_get_modes_batch,
+	sr_get_top_modes,
+	sr_prewarm_modes,
+	sr_get_refresh_ppm,
+	sr_get_fallback_rank,
 };
 
 #ifdef __cplusplus
@@ -87,6 +87,14 @@ typedef struct MODULE_API {
 	unsigned char interlace;
 } sr_mode;
 
+/* Mode request for batch calculation */
+typedef struct MODULE_API {
+	int width;
+	int height;
+	double refresh;
+	unsigned char interlace;
+} sr_mode_request;
+
 
 /* Declaration of the wrapper functions */
 MODULE_API void sr_init();
@@ -98,6 +106,14 @@ MODULE_API unsigned char sr_switch_to_mode(int, int, double, unsigned char, sr_m
 MODULE_API void sr_set_monitor(const char*);
 MODULE_API void sr_set_rotation(unsigned char);
 MODULE_API void sr_set_user_mode(int, int, int);
+MODULE_API int sr_get_modes_batch(const sr_mode_request*, sr_mode*, int);
+MODULE_API int sr_get_top_modes(const sr_mode_request*, sr_mode*, int); /* best first, the index is the rank */
+MODULE_API int sr_prewarm_modes(const sr_mode_request*, int);
+
+/* Details of the mode last returned by sr_add_mode or sr_switch_to_mode */
+MODULE_API double sr_get_refresh_ppm();
+/* 0 if the best mode was applied, n for the nth next best, -1 if none was */
+MODULE_API int sr_get_fallback_rank();
 
 /* Logging related functions */
 MODULE_API void sr_set_log_level (int);
@@ -124,6 +140,11 @@ typedef struct MODULE_API {
 	void (*sr_set_log_callback_error)(void *);
 	void (*sr_set_log_callback_info)(void *);
 	void (*sr_set_log_callback_debug)(void *);
+	int (*sr_get_modes_batch)(const sr_mode_request*, sr_mode*, int);
+	int (*sr_get_top_modes)(const sr_mode_request*, sr_mode*, int);
+	int (*sr_prewarm_modes)(const sr_mode_request*, int);
+	double (*sr_get_refresh_ppm)(void);
+	int (*sr_get_fallback_rank)(void);
 } srAPI;
 
 
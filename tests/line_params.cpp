@@ -0,0 +1,163 @@
+/**************************************************************
+
+   line_params.cpp - get_line_params differential test
+
+   ---------------------------------------------------------
+
+   Switchres   Modeline generation engine for emulation
+
+   License     GPL-2.0+
+   Copyright   2010-2021 Chris Kennedy, Antonio Giner,
+                         Alexandre Wodarczyk, Gil Delescluse
+
+ **************************************************************/
+
+// Checks the porch solver against the original one char at a time loop over
+// every preset range, hactive 1-4096, hfreq samples across each range and both
+// char sizes, then times both. Usage: line_params [hfreq samples per range]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include "modeline.h"
+#include "log.h"
+#include "test_common.h"
+
+using namespace std;
+
+int get_line_params(modeline *mode, const monitor_range *range, int char_size);
+
+//============================================================
+//  reference_line_params
+//============================================================
+
+static void reference_line_params(modeline *mode, const monitor_range *range, int char_size)
+{
+	// The loop get_line_params used before the solver
+	int hh, hs, he, ht;
+	double line_time, char_time, new_char_time;
+	double hfront_porch_min, hsync_pulse_min, hback_porch_min;
+
+	hfront_porch_min = range->hfront_porch * .90;
+	hsync_pulse_min  = range->hsync_pulse  * .90;
+	hback_porch_min  = range->hback_porch  * .90;
+
+	line_time = 1 / mode->hfreq * 1000000;
+
+	hh = round(mode->hactive / char_size);
+	hs = he = ht = 1;
+
+	do {
+		char_time = line_time / (hh + hs + he + ht);
+		if (hs * char_time < hfront_porch_min ||
+			fabs((hs + 1) * char_time - range->hfront_porch) < fabs(hs * char_time - range->hfront_porch))
+			hs++;
+
+		if (he * char_time < hsync_pulse_min ||
+			fabs((he + 1) * char_time - range->hsync_pulse) < fabs(he * char_time - range->hsync_pulse))
+			he++;
+
+		if (ht * char_time < hback_porch_min ||
+			fabs((ht + 1) * char_time - range->hback_porch) < fabs(ht * char_time - range->hback_porch))
+			ht++;
+
+		new_char_time = line_time / (hh + hs + he + ht);
+	} while (new_char_time != char_time);
+
+	mode->hbegin = (hh + hs) * char_size;
+	mode->hend   = (hh + hs + he) * char_size;
+	mode->htotal = (hh + hs + he + ht) * char_size;
+}
+
+//============================================================
+//  main
+//============================================================
+
+int main(int argc, char **argv)
+{
+	int samples = argc > 1? atoi(argv[1]) : 16;
+	vector<monitor_range> ranges;
+	long checked = 0, bad = 0;
+
+	set_log_verbosity(0);
+
+	for (auto preset : presets)
+	{
+		monitor_range range[MAX_RANGES];
+		memset(range, 0, sizeof(range));
+		monitor_set_preset((char *)preset, range);
+
+		for (int i = 0; i < MAX_RANGES && range[i].hfreq_min; i++)
+			ranges.push_back(range[i]);
+	}
+
+	for (auto &range : ranges)
+		for (int char_size = 1; char_size <= 8; char_size += 7)
+			for (int s = 0; s <= samples; s++)
+			{
+				// Both range ends, the samples in between and a value just off one of them
+				double hfreq = range.hfreq_min + (range.hfreq_max - range.hfreq_min) * s / samples;
+				if (s == samples / 3)
+					hfreq = nextafter(hfreq, 0);
+
+				for (int hactive = 1; hactive <= 4096; hactive++)
+				{
+					modeline a = {}, b = {};
+					a.hactive = b.hactive = hactive;
+					a.hfreq = b.hfreq = hfreq;
+
+					reference_line_params(&a, &range, char_size);
+					get_line_params(&b, &range, char_size);
+					checked++;
+
+					if (a.hbegin != b.hbegin || a.hend != b.hend || a.htotal != b.htotal)
+					{
+						if (bad++ < 10)
+							printf("mismatch: hfreq %.17g hactive %d char %d: %d %d %d, expected %d %d %d\n", hfreq, hactive, char_size,
+								b.hbegin, b.hend, b.htotal, a.hbegin, a.hend, a.htotal);
+					}
+				}
+			}
+
+	printf("line_params: %zu ranges, %ld cases, %ld mismatches\n", ranges.size(), checked, bad);
+
+	// Time both on the same inputs, with each char size
+	for (int char_size = 8; char_size >= 1; char_size -= 7)
+	{
+		double ns[2] = {};
+		long calls = 0;
+		volatile int sink = 0;
+
+		for (int pass = 0; pass < 2; pass++)
+		{
+			auto start = chrono::steady_clock::now();
+			calls = 0;
+
+			for (int rep = 0; rep < 50; rep++)
+			for (auto &range : ranges)
+				for (int hactive = 64; hactive <= 2048; hactive += 8)
+				{
+					modeline mode = {};
+					mode.hactive = hactive;
+					mode.hfreq = (range.hfreq_min + range.hfreq_max) / 2;
+
+					if (pass == 0)
+						reference_line_params(&mode, &range, char_size);
+					else
+						get_line_params(&mode, &range, char_size);
+
+					sink = sink + mode.htotal;
+					calls++;
+				}
+
+			ns[pass] = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / calls;
+		}
+
+		printf("line_params: char size %d, loop %.1f ns/call, solver %.1f ns/call, %.1fx\n", char_size, ns[0], ns[1], ns[0] / ns[1]);
+	}
+
+	return bad? 1 : 0;
+}
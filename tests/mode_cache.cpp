@@ -0,0 +1,239 @@
+/**************************************************************
+
+   mode_cache.cpp - get_mode result cache test
+
+   ---------------------------------------------------------
+
+   Switchres   Modeline generation engine for emulation
+
+   License     GPL-2.0+
+   Copyright   2010-2021 Chris Kennedy, Antonio Giner,
+                         Alexandre Wodarczyk, Gil Delescluse
+
+ **************************************************************/
+
+// get_mode results are cached by request, settings and mode list generation. Each
+// check runs the same steps on two displays, one of them with its cache cleared
+// before every request, and the results must match. A repeated request must be
+// answered from the cache whenever the search picks an entry already in the list:
+// the caller may keep the mode get_mode added, drop it again or apply it as
+// sr_switch_to_mode does. Then random sequences of requests, applies, geometry
+// changes, dropped entries and restores are checked.
+
+#include <stdio.h>
+#include <string.h>
+#include <random>
+#include "switchres.h"
+#include "log.h"
+#include "test_common.h"
+
+using namespace std;
+
+static const mode_request requests[] = { { 320, 240, 60, false }, { 320, 240, 59.94f, false }, { 256, 224, 60, false },
+	{ 384, 224, 59.63f, false }, { 640, 480, 60, false }, { 288, 224, 60.606f, false }, { 640, 480, 60, true } };
+#define NUM_REQUESTS (int)(sizeof(requests) / sizeof(requests[0]))
+
+enum { KEEP_MODE, DROP_MODE, APPLY_MODE };
+
+// A backend that takes every change
+class test_video : public custom_video
+{
+public:
+	int caps() { return CUSTOM_VIDEO_CAPS_ADD | CUSTOM_VIDEO_CAPS_UPDATE; }
+	bool add_mode(modeline *) { return true; }
+	bool update_mode(modeline *) { return true; }
+};
+
+//============================================================
+//  make_display
+//============================================================
+
+static display_manager *make_display(switchres_manager &switchres, const char *preset, bool mode_list, test_video *video)
+{
+	display_manager *display = make_display(switchres, preset, video);
+
+	if (mode_list)
+	{
+		const int modes[][4] = { { 640, 480, 60, MODE_DESKTOP }, { 320, 240, 60, V_FREQ_EDITABLE }, { 800, 600, 60, 0 },
+			{ 384, 224, 59, V_FREQ_EDITABLE }, { 256, 240, 60, V_FREQ_EDITABLE | SCAN_EDITABLE } };
+
+		add_modes(display, modes);
+	}
+
+	display->filter_modes();
+	return display;
+}
+
+//============================================================
+//  same_result
+//============================================================
+
+static bool same_result(display_manager *display[2], modeline *mode[2])
+{
+	if (!mode[0] || !mode[1])
+		return mode[0] == mode[1];
+
+	return !memcmp(mode[0], mode[1], offsetof(modeline, result)) && display[0]->video_modes.size() == display[1]->video_modes.size()
+		&& display[0]->is_switching_required() == display[1]->is_switching_required();
+}
+
+//============================================================
+//  get_mode
+//============================================================
+
+static bool get_mode(display_manager *display[2], const mode_request &request, modeline *mode[2])
+{
+	display[1]->clear_mode_cache();
+	for (int d = 0; d < 2; d++)
+		mode[d] = display[d]->get_mode(request.width, request.height, request.refresh, request.interlace);
+
+	return same_result(display, mode);
+}
+
+//============================================================
+//  check_repeats
+//============================================================
+
+static long check_repeats(switchres_manager &switchres, long *calls, long *hits)
+{
+	long bad = 0;
+
+	for (int p = 0; p < NUM_PRESETS; p++)
+		for (int mode_list = 0; mode_list <= 1; mode_list++)
+			for (int generation = 0; generation <= 1; generation++)
+				for (int pattern = KEEP_MODE; pattern <= APPLY_MODE; pattern++)
+					for (auto &request : requests)
+					{
+						test_video video[2];
+						display_manager *display[2];
+						for (int d = 0; d < 2; d++)
+						{
+							display[d] = make_display(switchres, presets[p], mode_list, &video[d]);
+							display[d]->set_modeline_generation(generation);
+						}
+
+						size_t table_size = display[0]->video_modes.size();
+						for (int i = 0; i < 10; i++)
+						{
+							int cache_hits = display[0]->mode_cache_hits();
+							size_t list_size = display[1]->video_modes.size();
+							modeline *mode[2];
+							bool ok = get_mode(display, request, mode);
+
+							// A search adding the mode again can't be answered from the cache
+							bool expect_hit = i > 0 && (pattern == DROP_MODE || display[1]->video_modes.size() == list_size);
+							bool hit = display[0]->mode_cache_hits() > cache_hits;
+							*calls += i > 0;
+							*hits += i > 0 && hit;
+
+							if ((!ok || hit != expect_hit) && bad++ < 10)
+								printf("%s%s%s %dx%d@%g call %d pattern %d: %s\n", presets[p], mode_list? " list" : "", generation? " generation" : "",
+									request.width, request.height, request.refresh, i, pattern, ok? (hit? "unexpected hit" : "missed") : "results differ");
+
+							for (int d = 0; d < 2 && mode[d]; d++)
+							{
+								if (pattern == DROP_MODE)
+									display[d]->video_modes.resize(table_size);
+
+								else if (pattern == APPLY_MODE && display[d]->apply_best_mode())
+									display[d]->set_current_mode(display[d]->best_mode());
+							}
+						}
+
+						delete display[0];
+						delete display[1];
+					}
+
+	return bad;
+}
+
+//============================================================
+//  check_sequences
+//============================================================
+
+static long check_sequences(switchres_manager &switchres, long *steps)
+{
+	mt19937 rng(7);
+	long bad = 0;
+
+	for (int p = 0; p < NUM_PRESETS; p++)
+		for (int mode_list = 0; mode_list <= 1; mode_list++)
+			for (int generation = 0; generation <= 1; generation++)
+			{
+				test_video video[2];
+				display_manager *display[2];
+				for (int d = 0; d < 2; d++)
+				{
+					display[d] = make_display(switchres, presets[p], mode_list, &video[d]);
+					display[d]->set_modeline_generation(generation);
+				}
+
+				size_t table_size = display[0]->video_modes.size();
+				for (int i = 0; i < 200; i++)
+				{
+					int step = rng() % 10;
+					bool ok = true;
+
+					if (step < 5)
+					{
+						modeline *mode[2];
+						ok = get_mode(display, requests[rng() % NUM_REQUESTS], mode);
+					}
+					else if (step < 7 && display[0]->got_mode() && display[1]->got_mode())
+					{
+						bool applied[2];
+						for (int d = 0; d < 2; d++)
+							if ((applied[d] = display[d]->apply_best_mode()))
+								display[d]->set_current_mode(display[d]->best_mode());
+
+						ok = applied[0] == applied[1];
+					}
+					else if (step == 7)
+					{
+						size_t size = table_size + rng() % 3;
+						if (size < display[0]->video_modes.size())
+							for (int d = 0; d < 2; d++)
+								display[d]->video_modes.resize(size);
+					}
+					else if (step == 8 && display[0]->got_mode() && display[1]->got_mode())
+					{
+						double h_size = 0.9 + (rng() % 5) * 0.05;
+						int h_shift = int(rng() % 5) - 2;
+						ok = display[0]->adjust_geometry(h_size, h_shift, 0) == display[1]->adjust_geometry(h_size, h_shift, 0);
+					}
+					else if (step == 9)
+					{
+						display[0]->restore_modes();
+						display[1]->restore_modes();
+					}
+
+					(*steps)++;
+					if (!ok && bad++ < 10)
+						printf("%s%s%s step %d (%d): results differ\n", presets[p], mode_list? " list" : "", generation? " generation" : "", i, step);
+				}
+
+				delete display[0];
+				delete display[1];
+			}
+
+	return bad;
+}
+
+//============================================================
+//  main
+//============================================================
+
+int main()
+{
+	switchres_manager switchres;
+	switchres.set_log_level(0);
+
+	long calls = 0, hits = 0, steps = 0;
+	long bad = check_repeats(switchres, &calls, &hits);
+	printf("mode_cache: %ld repeated requests, %ld answered from the cache, %ld mismatches\n", calls, hits, bad);
+
+	long sequence_bad = check_sequences(switchres, &steps);
+	printf("mode_cache: %ld random steps, %ld mismatches\n", steps, sequence_bad);
+
+	return bad || sequence_bad? 1 : 0;
+}
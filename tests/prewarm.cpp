@@ -0,0 +1,78 @@
+/**************************************************************
+
+   prewarm.cpp - prewarm_modes test
+
+   ---------------------------------------------------------
+
+   Switchres   Modeline generation engine for emulation
+
+   License     GPL-2.0+
+   Copyright   2010-2021 Chris Kennedy, Antonio Giner,
+                         Alexandre Wodarczyk, Gil Delescluse
+
+ **************************************************************/
+
+// prewarm_modes adds the modes a list of requests needs in one batch. Asking
+// get_mode for the same requests afterwards must pick the prewarmed entries
+// as they are: nothing new is added to the list or sent to the backend.
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "switchres.h"
+#include "log.h"
+#include "test_common.h"
+
+using namespace std;
+
+static const mode_request requests[] = { { 320, 240, 60, false }, { 256, 224, 60, false }, { 384, 224, 59.63f, false },
+	{ 288, 224, 60.606f, false }, { 640, 480, 60, true } };
+
+// A backend that can only add modes, and counts them
+class add_only_video : public custom_video
+{
+public:
+	int caps() { return CUSTOM_VIDEO_CAPS_ADD; }
+	bool add_mode(modeline *) { added++; return true; }
+	int added = 0;
+};
+
+//============================================================
+//  main
+//============================================================
+
+int main()
+{
+	switchres_manager switchres;
+	switchres.set_log_level(0);
+
+	vector<mode_request> list(requests, requests + sizeof(requests) / sizeof(requests[0]));
+	long prewarmed = 0, picked = 0, bad = 0;
+
+	for (int p = 0; p < NUM_PRESETS; p++)
+	{
+		add_only_video video;
+		display_manager *display = make_display(switchres, presets[p], &video);
+		display->filter_modes();
+
+		prewarmed += display->prewarm_modes(list);
+		int added = video.added;
+		size_t list_size = display->video_modes.size();
+
+		for (auto &request : list)
+		{
+			modeline *mode = display->get_mode(request.width, request.height, request.refresh, request.interlace);
+			bool ok = mode == nullptr || (!(mode->type & (MODE_ADD | MODE_UPDATE)) && display->apply_best_mode());
+
+			if (ok && mode) picked++;
+			if ((!ok || video.added != added || display->video_modes.size() != list_size) && bad++ < 10)
+				printf("%s %dx%d@%g%s: prewarmed mode not picked\n", presets[p], request.width, request.height, request.refresh, request.interlace? "i" : "");
+		}
+
+		delete display;
+	}
+
+	printf("prewarm: %ld modes prewarmed, %ld requests picked them, %ld mismatches\n", prewarmed, picked, bad);
+
+	return bad? 1 : 0;
+}
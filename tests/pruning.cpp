@@ -0,0 +1,178 @@
+/**************************************************************
+
+   pruning.cpp - Candidate pruning and timing engine test
+
+   ---------------------------------------------------------
+
+   Switchres   Modeline generation engine for emulation
+
+   License     GPL-2.0+
+   Copyright   2010-2021 Chris Kennedy, Antonio Giner,
+                         Alexandre Wodarczyk, Gil Delescluse
+
+ **************************************************************/
+
+// find_best_mode skips a candidate when its weight bound can't beat the current
+// best, which only leaves the selected mode unchanged if the bound never claims
+// a weight bit the full generation doesn't set. This checks that on random
+// modes, ranges and settings with both timing engines, then checks get_mode
+// picks the same mode with the same weight on either engine for random requests.
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <stdlib.h>
+#include <random>
+#include "switchres.h"
+#include "log.h"
+#include "test_common.h"
+
+using namespace std;
+
+//============================================================
+//  check_bounds
+//============================================================
+
+static long check_bounds(int timing_engine, long *checked)
+{
+	long bad = 0;
+
+	for (int i = 0; i < 300000; i++)
+	{
+		monitor_range range[MAX_RANGES];
+		memset(range, 0, sizeof(range));
+		monitor_set_preset((char *)presets[i % NUM_PRESETS], range);
+
+		generator_settings cs = {};
+		cs.timing_engine = timing_engine;
+		cs.interlace = rand_int(0, 1);
+		cs.doublescan = rand_int(0, 1);
+		cs.v_shift_correct = rand_int(0, 3) == 0;
+		cs.pixel_precision = rand_int(0, 1);
+		cs.refresh_tolerance = rand_int(0, 1)? rand_real(0, 3) : 0;
+		cs.h_size = 1.0;
+		cs.super_width = rand_int(0, 1)? 2560 : 0;
+
+		modeline s_mode = {}, t_mode = {};
+		s_mode.hactive = s_mode.width = rand_int(64, 1600);
+		s_mode.vactive = s_mode.height = rand_int(100, 1200);
+		s_mode.vfreq = rand_int(0, 3)? rand_real(20, 130) : rand_int(45, 65);
+		s_mode.interlace = rand_int(0, 1);
+
+		// Editable fields come from the source, as template_mode does
+		t_mode.type = rand_int(0, 15);
+		t_mode.hactive = t_mode.width = t_mode.type & X_RES_EDITABLE? s_mode.hactive : rand_int(256, 1600);
+		t_mode.vactive = t_mode.height = t_mode.type & Y_RES_EDITABLE? s_mode.vactive : rand_int(192, 1200);
+		t_mode.vfreq = t_mode.type & V_FREQ_EDITABLE? s_mode.vfreq : rand_real(47, 85);
+		t_mode.interlace = rand_int(0, 1);
+
+		for (int k = 0; k < MAX_RANGES && range[k].hfreq_min; k++)
+		{
+			int bound = modeline_weight_bound(&s_mode, &t_mode, &range[k], &cs);
+			modeline mode = modeline_generate(&s_mode, &t_mode, &range[k], &cs);
+			(*checked)++;
+
+			// Out of range candidates are skipped whatever their bound
+			if (mode.result.weight & R_OUT_OF_RANGE)
+				continue;
+
+			if ((bound & ~mode.result.weight) && bad++ < 10)
+				printf("engine %d %s range %d: bound %x not within weight %x (type %x, %dx%d@%g -> %dx%d@%g)\n", timing_engine,
+					presets[i % NUM_PRESETS], k, bound, mode.result.weight, t_mode.type,
+					s_mode.hactive, s_mode.vactive, s_mode.vfreq, t_mode.hactive, t_mode.vactive, t_mode.vfreq);
+		}
+	}
+
+	return bad;
+}
+
+//============================================================
+//  make_display
+//============================================================
+
+static display_manager *make_display(switchres_manager &switchres, const char *preset, int timing_engine, bool mode_list)
+{
+	switchres.set_timing_engine(timing_engine);
+	display_manager *display = make_display(switchres, preset, nullptr);
+
+	if (mode_list)
+	{
+		const int modes[][4] = { { 640, 480, 60, MODE_DESKTOP }, { 320, 240, 60, V_FREQ_EDITABLE }, { 800, 600, 60, 0 },
+			{ 640, 480, 60, V_FREQ_EDITABLE | SCAN_EDITABLE }, { 384, 224, 59, V_FREQ_EDITABLE }, { 1024, 768, 75, V_FREQ_EDITABLE },
+			{ 2560, 240, 60, V_FREQ_EDITABLE | X_RES_EDITABLE } };
+
+		add_modes(display, modes);
+		display->filter_modes();
+	}
+
+	return display;
+}
+
+//============================================================
+//  main
+//============================================================
+
+int main()
+{
+	switchres_manager switchres;
+	switchres.set_log_level(0);
+	rng.seed(11);
+
+	long checked = 0, bad = 0;
+	bad += check_bounds(TIMING_ENGINE_DOUBLE, &checked);
+	bad += check_bounds(TIMING_ENGINE_FIXED, &checked);
+	printf("pruning: %ld weight bounds, %ld above the generated weight\n", checked, bad);
+
+	// get_mode with both engines. They may break near ties differently and the
+	// fixed one truncates the pixel clock to 1 Hz, so totals can differ by a char.
+	long requests = 0, mode_bad = 0, same_timings = 0;
+
+	for (int p = 0; p < NUM_PRESETS; p++)
+		for (int mode_list = 0; mode_list <= 1; mode_list++)
+		{
+			display_manager *display[2] = { make_display(switchres, presets[p], TIMING_ENGINE_DOUBLE, mode_list),
+				make_display(switchres, presets[p], TIMING_ENGINE_FIXED, mode_list) };
+
+			for (int i = 0; i < 200; i++)
+			{
+				int width = rand_int(0, 3)? rand_int(160, 800) : rand_int(8, 2048);
+				int height = rand_int(0, 3)? rand_int(144, 600) : rand_int(8, 1280);
+				double refresh = rand_int(0, 3)? rand_real(47, 75) : rand_real(24, 130);
+				bool interlace = rand_int(0, 5) == 0;
+
+				modeline mode[2] = {};
+				int index[2] = { -1, -1 };
+
+				for (int e = 0; e < 2; e++)
+				{
+					modeline *m = display[e]->get_mode(width, height, refresh, interlace);
+					if (!m) continue;
+					mode[e] = *m;
+					index[e] = display[e]->video_modes.index(display[e]->video_modes.find(m));
+				}
+				requests++;
+
+				modeline &a = mode[0], &b = mode[1];
+				bool same_mode = index[0] == index[1] && a.width == b.width && a.height == b.height && a.interlace == b.interlace &&
+					a.result.weight == b.result.weight && a.vtotal == b.vtotal && abs(a.htotal - b.htotal) <= 8 && fabs(a.vfreq - b.vfreq) <= 1e-5;
+
+				if (same_mode && a.htotal == b.htotal)
+				{
+					same_mode = llabs((long long)a.pclock - (long long)b.pclock) <= 16;
+					same_timings++;
+				}
+
+				if (!same_mode && mode_bad++ < 10)
+					printf("%s %dx%d@%g%s: #%d %dx%d%s %d/%d %.9g weight %x, fixed #%d %dx%d%s %d/%d %.9g weight %x\n", presets[p], width, height, refresh, interlace? "i" : "",
+						index[0], a.width, a.height, a.interlace? "i" : "", a.htotal, a.vtotal, a.vfreq, a.result.weight,
+						index[1], b.width, b.height, b.interlace? "i" : "", b.htotal, b.vtotal, b.vfreq, b.result.weight);
+			}
+
+			delete display[0];
+			delete display[1];
+		}
+
+	printf("pruning: %ld get_mode requests, %ld with the same timings on both engines, %ld mismatches\n", requests, same_timings, mode_bad);
+
+	return bad || mode_bad? 1 : 0;
+}
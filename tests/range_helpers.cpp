@@ -0,0 +1,230 @@
+/**************************************************************
+
+   range_helpers.cpp - Monitor range helper differential test
+
+   ---------------------------------------------------------
+
+   Switchres   Modeline generation engine for emulation
+
+   License     GPL-2.0+
+   Copyright   2010-2021 Chris Kennedy, Antonio Giner,
+                         Alexandre Wodarczyk, Gil Delescluse
+
+ **************************************************************/
+
+// Checks the closed form range helpers against the original stepping loops on
+// random values and the preset ranges, and the multi-range weight bound kernel
+// against the scalar bound of each range on random ranges and modes.
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "modeline.h"
+#include "log.h"
+#include "test_common.h"
+
+using namespace std;
+
+int scale_into_range (int value, int lower_limit, int higher_limit);
+int scale_into_range (double value, double lower_limit, double higher_limit);
+int stretch_into_range(double vfreq, const monitor_range *range, double borders, bool interlace_allowed, double *interlace);
+int total_lines_for_yres(int yres, double vfreq, const monitor_range *range, double borders, double interlace);
+
+//============================================================
+//  Original implementations
+//============================================================
+
+template <typename T> static int reference_scale_into_range(T value, T lower_limit, T higher_limit)
+{
+	int scale = 1;
+	while (value * scale < lower_limit) scale ++;
+	return value * scale <= higher_limit? scale : 0;
+}
+
+static double reference_max_vfreq_for_yres(int yres, const monitor_range *range, double borders, double interlace)
+{
+	return range->hfreq_max / (yres / interlace + round_near(range->hfreq_max * (range->vertical_blank + borders)));
+}
+
+static int reference_stretch_into_range(double vfreq, const monitor_range *range, double borders, bool interlace_allowed, double *interlace)
+{
+	int yres, lower_limit;
+
+	if (range->interlaced_lines_min && interlace_allowed)
+	{
+		yres = range->interlaced_lines_max;
+		lower_limit = range->interlaced_lines_min;
+		*interlace = 2;
+	}
+	else
+	{
+		yres = range->progressive_lines_max;
+		lower_limit = range->progressive_lines_min;
+	}
+
+	while (yres > lower_limit && reference_max_vfreq_for_yres(yres, range, borders, *interlace) < vfreq)
+		yres -= 8;
+
+	return yres;
+}
+
+static int reference_total_lines_for_yres(int yres, double vfreq, const monitor_range *range, double borders, double interlace)
+{
+	int vvt = max(yres / interlace + round_near(vfreq * yres / (interlace * (1.0 - vfreq * (range->vertical_blank + borders))) * (range->vertical_blank + borders)), 1.0);
+	while ((vfreq * vvt < range->hfreq_min) && (vfreq * (vvt + 1) < range->hfreq_max)) vvt++;
+	return vvt;
+}
+
+//============================================================
+//  random_ranges
+//============================================================
+
+static void random_ranges(monitor_range *range)
+{
+	memset(range, 0, sizeof(monitor_range) * MAX_RANGES);
+
+	for (int i = rand_int(1, MAX_RANGES); i--; )
+	{
+		monitor_range &r = range[i];
+		r.hfreq_min = rand_real(14000, 40000);
+		r.hfreq_max = r.hfreq_min + rand_real(0, 30000);
+		r.vfreq_min = rand_real(40, 70);
+		r.vfreq_max = r.vfreq_min + rand_real(0, 60);
+		r.vertical_blank = rand_real(0.0005, 0.002);
+		r.progressive_lines_min = rand_int(0, 1)? rand_int(128, 600) : 0;
+		r.progressive_lines_max = r.progressive_lines_min + rand_int(0, 400);
+		r.interlaced_lines_min = rand_int(0, 1)? rand_int(300, 900) : 0;
+		r.interlaced_lines_max = r.interlaced_lines_min + rand_int(0, 400);
+		if (!r.progressive_lines_min && !r.interlaced_lines_min)
+			r.progressive_lines_min = r.progressive_lines_max = 240;
+	}
+}
+
+//============================================================
+//  main
+//============================================================
+
+int main()
+{
+	vector<monitor_range> ranges;
+	long checked = 0, bad = 0;
+	rng.seed(7);
+
+	set_log_verbosity(0);
+
+	for (auto preset : presets)
+	{
+		monitor_range range[MAX_RANGES];
+		memset(range, 0, sizeof(range));
+		monitor_set_preset((char *)preset, range);
+
+		for (int i = 0; i < MAX_RANGES && range[i].hfreq_min; i++)
+			ranges.push_back(range[i]);
+	}
+
+	// scale_into_range, including exact multiples of the lower limit
+	for (int i = 0; i < 2000000; i++)
+	{
+		int value = rand_int(1, 3000), lower = rand_int(0, 5000), higher = lower + rand_int(0, 5000);
+		if (reference_scale_into_range(value, lower, higher) != scale_into_range(value, lower, higher) && bad++ < 10)
+			printf("scale_into_range(%d, %d, %d): %d, expected %d\n", value, lower, higher,
+				scale_into_range(value, lower, higher), reference_scale_into_range(value, lower, higher));
+
+		double dvalue = rand_real(1e-3, 200), dlower = rand_real(0, 1) * rand_real(0, 20000), dhigher = dlower + rand_real(0, 20000);
+		if (i % 4 == 0)
+		{
+			dvalue = round(dvalue);
+			dlower = dvalue * rand_int(0, 49);
+		}
+		if (reference_scale_into_range(dvalue, dlower, dhigher) != scale_into_range(dvalue, dlower, dhigher) && bad++ < 10)
+			printf("scale_into_range(%.17g, %.17g, %.17g): %d, expected %d\n", dvalue, dlower, dhigher,
+				scale_into_range(dvalue, dlower, dhigher), reference_scale_into_range(dvalue, dlower, dhigher));
+
+		checked += 2;
+	}
+
+	// stretch_into_range and total_lines_for_yres on the preset ranges
+	for (int i = 0; i < 1000000; i++)
+	{
+		const monitor_range &range = ranges[rng() % ranges.size()];
+		double borders = rng() % 3? 0 : rand_real(0, 0.002);
+		double vfreq = i % 5? rand_real(20, 220) : rand_real(range.vfreq_min, range.vfreq_max);
+		bool interlace_allowed = rng() % 2;
+		double ref_interlace = 1, interlace = 1;
+
+		int ref_yres = reference_stretch_into_range(vfreq, &range, borders, interlace_allowed, &ref_interlace);
+		int yres = stretch_into_range(vfreq, &range, borders, interlace_allowed, &interlace);
+		if ((ref_yres != yres || ref_interlace != interlace) && bad++ < 10)
+			printf("stretch_into_range(%.17g, %.17g, %d): %d %g, expected %d %g\n", vfreq, borders, interlace_allowed,
+				yres, interlace, ref_yres, ref_interlace);
+		checked++;
+
+		// Only valid while the blanking leaves room for active lines
+		int height = rand_int(1, 1200);
+		interlace = rng() % 2? 2 : 1;
+		if (vfreq * (range.vertical_blank + borders) >= 1)
+			continue;
+
+		int ref_lines = reference_total_lines_for_yres(height, vfreq, &range, borders, interlace);
+		int lines = total_lines_for_yres(height, vfreq, &range, borders, interlace);
+		if (ref_lines != lines && bad++ < 10)
+			printf("total_lines_for_yres(%d, %.17g, %.17g, %g): %d, expected %d\n", height, vfreq, borders, interlace, lines, ref_lines);
+		checked++;
+	}
+
+	printf("range_helpers: %ld helper cases, %ld mismatches\n", checked, bad);
+
+	// modeline_weight_bounds against modeline_weight_bound of each range
+	long bound_checked = 0, bound_bad = 0;
+
+	for (int i = 0; i < 100000; i++)
+	{
+		monitor_range range[MAX_RANGES];
+		memset(range, 0, sizeof(range));
+		if (i % 3)
+			monitor_set_preset((char *)presets[i % NUM_PRESETS], range);
+		else
+			random_ranges(range);
+
+		range_set set;
+		range_set_build(&set, range);
+
+		for (int j = 0; j < 20; j++)
+		{
+			generator_settings cs = {};
+			cs.interlace = rand_int(0, 1);
+			cs.doublescan = rand_int(0, 1);
+			cs.v_shift_correct = rand_int(0, 3) == 0;
+			cs.refresh_tolerance = rand_real(0, 3);
+
+			modeline s_mode = {}, t_mode = {};
+			s_mode.vactive = rand_int(0, 8)? rand_int(100, 1200) : rand_int(1, 20);
+			s_mode.hactive = rand_int(64, 1600);
+			s_mode.vfreq = rand_int(0, 3)? rand_real(20, 130) : rand_int(45, 65);
+			s_mode.interlace = rand_int(0, 1);
+			t_mode.vactive = rand_int(0, 1)? s_mode.vactive : rand_int(100, 1200);
+			t_mode.vfreq = rand_int(0, 1)? s_mode.vfreq : rand_real(30, 130);
+			t_mode.interlace = rand_int(0, 1);
+			t_mode.type = rand_int(0, 15);
+
+			int weights[RANGE_SET_SIZE];
+			modeline_weight_bounds(&s_mode, &t_mode, range, &set, &cs, weights);
+
+			for (int k = 0; k < set.count; k++)
+			{
+				int ref = modeline_weight_bound(&s_mode, &t_mode, &range[set.index[k]], &cs);
+				if (ref != weights[k] && bound_bad++ < 10)
+					printf("modeline_weight_bounds lane %d: %x, expected %x (type %x, %dx%d@%g -> %d@%g)\n", k, weights[k], ref,
+						t_mode.type, s_mode.hactive, s_mode.vactive, s_mode.vfreq, t_mode.vactive, t_mode.vfreq);
+				bound_checked++;
+			}
+		}
+	}
+
+	printf("range_helpers: %ld weight bound lanes, %ld mismatches\n", bound_checked, bound_bad);
+
+	return bad || bound_bad? 1 : 0;
+}
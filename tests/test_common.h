@@ -0,0 +1,80 @@
+/**************************************************************
+
+   test_common.h - Helpers shared by the tests and benchmarks
+
+   ---------------------------------------------------------
+
+   Switchres   Modeline generation engine for emulation
+
+   License     GPL-2.0+
+   Copyright   2010-2021 Chris Kennedy, Antonio Giner,
+                         Alexandre Wodarczyk, Gil Delescluse
+
+ **************************************************************/
+
+#ifndef __TEST_COMMON_H__
+#define __TEST_COMMON_H__
+
+#include <random>
+#include "switchres.h"
+
+//============================================================
+//  Monitor presets
+//============================================================
+
+static const char *const presets[] = { "generic_15", "arcade_15", "arcade_15ex", "arcade_25", "arcade_31", "arcade_15_25", "arcade_15_31",
+	"arcade_15_25_31", "m2929", "d9800", "d9200", "k7000", "k7131", "m3129", "h9110", "pstar", "ms2930", "ms929", "r666b",
+	"pc_31_120", "pc_70_120", "vesa_480", "vesa_600", "vesa_768", "vesa_1024", "pal", "ntsc" };
+#define NUM_PRESETS (int)(sizeof(presets) / sizeof(presets[0]))
+
+//============================================================
+//  Random values, each test seeds rng before using it
+//============================================================
+
+static std::mt19937_64 rng;
+static inline double rand_real(double a, double b) { return std::uniform_real_distribution<double>(a, b)(rng); }
+static inline int rand_int(int a, int b) { return std::uniform_int_distribution<int>(a, b)(rng); }
+
+//============================================================
+//  make_display
+//============================================================
+
+static inline display_manager *make_display(switchres_manager &switchres, const char *preset, custom_video *video)
+{
+	// Base display manager on the switchres settings. Without a backend it's
+	// a "ram" screen where new modes can be added
+	display_manager *display = new display_manager();
+	display->m_ds = switchres.ds;
+	display->set_monitor(preset);
+	display->set_keep_changes(true);
+	display->parse_options();
+
+	if (video)
+		display->set_custom_video(video);
+	else
+		display->init();
+
+	return display;
+}
+
+//============================================================
+//  add_modes
+//============================================================
+
+template <size_t N> static inline void add_modes(display_manager *display, const int (&modes)[N][4])
+{
+	// Appends { width, height, refresh, type } modes with GTF timings
+	for (auto &m : modes)
+	{
+		modeline mode = {};
+		mode.width = mode.hactive = m[0];
+		mode.height = mode.vactive = m[1];
+		mode.refresh = m[2];
+		mode.vfreq = m[2];
+		modeline_vesa_gtf(&mode);
+		mode.type = m[3];
+		display->video_modes.push_back(mode);
+	}
+}
+
+#endif
@@ -0,0 +1,148 @@
+/**************************************************************
+
+   work_pool.cpp - Persistent work stealing thread pool
+
+   ---------------------------------------------------------
+
+   Switchres   Modeline generation engine for emulation
+
+   License     GPL-2.0+
+   Copyright   2010-2021 Chris Kennedy, Antonio Giner,
+                         Alexandre Wodarczyk, Gil Delescluse
+
+ **************************************************************/
+
+#include <algorithm>
+#include "work_pool.h"
+#include "log.h"
+
+std::mutex work_pool::s_shared_lock;
+work_pool *work_pool::s_shared = nullptr;
+
+//============================================================
+//  work_pool::work_pool
+//============================================================
+
+work_pool::work_pool(int num_workers)
+{
+	m_num_workers = std::max(1, std::min(num_workers, WORK_POOL_MAX_WORKERS));
+
+	for (int w = 1; w < m_num_workers; w++)
+		m_threads.emplace_back(&work_pool::worker_main, this, w);
+
+	log_verbose("Switchres: work pool started with %d threads\n", m_num_workers);
+}
+
+//============================================================
+//  work_pool::~work_pool
+//============================================================
+
+work_pool::~work_pool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_quit = true;
+	}
+	m_wake.notify_all();
+
+	for (auto &thread : m_threads)
+		thread.join();
+}
+
+//============================================================
+//  work_pool::shared
+//============================================================
+
+work_pool *work_pool::shared()
+{
+	std::lock_guard<std::mutex> lock(s_shared_lock);
+	if (s_shared == nullptr)
+		s_shared = new work_pool(std::thread::hardware_concurrency());
+
+	return s_shared;
+}
+
+//============================================================
+//  work_pool::shutdown
+//============================================================
+
+void work_pool::shutdown()
+{
+	// Joining threads at static destruction can deadlock (under the loader
+	// lock on Windows), so the owner stops them. shared() starts a new pool
+	std::lock_guard<std::mutex> lock(s_shared_lock);
+	delete s_shared;
+	s_shared = nullptr;
+}
+
+//============================================================
+//  work_pool::run
+//============================================================
+
+void work_pool::run(int count, const std::function<void(int, int)> &task)
+{
+	std::lock_guard<std::mutex> run_lock(m_run_lock);
+
+	for (int w = 0; w < m_num_workers; w++)
+	{
+		m_shares[w].next = (long long)count * w / m_num_workers;
+		m_shares[w].end = (long long)count * (w + 1) / m_num_workers;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_task = &task;
+		m_busy = m_num_workers - 1;
+		m_generation++;
+	}
+	m_wake.notify_all();
+
+	work(0);
+
+	std::unique_lock<std::mutex> lock(m_lock);
+	m_done.wait(lock, [this]() { return m_busy == 0; });
+	m_task = nullptr;
+}
+
+//============================================================
+//  work_pool::work
+//============================================================
+
+void work_pool::work(int worker)
+{
+	// Own share first, then the other shares in turn
+	for (int i = 0; i < m_num_workers; i++)
+	{
+		work_share &share = m_shares[(worker + i) % m_num_workers];
+
+		for (int index; (index = share.next++) < share.end;)
+			(*m_task)(index, worker);
+	}
+}
+
+//============================================================
+//  work_pool::worker_main
+//============================================================
+
+void work_pool::worker_main(int worker)
+{
+	unsigned generation = 0;
+
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_lock);
+			m_wake.wait(lock, [&]() { return m_quit || m_generation != generation; });
+			if (m_quit)
+				return;
+
+			generation = m_generation;
+		}
+
+		work(worker);
+
+		std::lock_guard<std::mutex> lock(m_lock);
+		if (--m_busy == 0)
+			m_done.notify_one();
+	}
+}
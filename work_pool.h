@@ -0,0 +1,84 @@
+/**************************************************************
+
+   work_pool.h - Persistent work stealing thread pool header
+
+   ---------------------------------------------------------
+
+   Switchres   Modeline generation engine for emulation
+
+   License     GPL-2.0+
+   Copyright   2010-2021 Chris Kennedy, Antonio Giner,
+                         Alexandre Wodarczyk, Gil Delescluse
+
+ **************************************************************/
+
+#ifndef __WORK_POOL_H__
+#define __WORK_POOL_H__
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+//============================================================
+//  CONSTANTS
+//============================================================
+
+// Threads of the shared pool at most, the calling thread included
+#define WORK_POOL_MAX_WORKERS 8
+
+//============================================================
+//  TYPE DEFINITIONS
+//============================================================
+
+class work_pool
+{
+public:
+	work_pool(int num_workers);
+	~work_pool();
+
+	// Runs task(index, worker) for every index in [0, count) and returns when
+	// all are done. The calling thread is worker 0. Each worker starts on its
+	// own share of the indexes and then steals from the others' shares.
+	void run(int count, const std::function<void(int, int)> &task);
+	int workers() const { return m_num_workers; }
+
+	// Pool shared by all display managers, started on first use. Its threads are
+	// only stopped by shutdown, never from a static destructor, and it must not
+	// be running tasks then
+	static work_pool *shared();
+	static void shutdown();
+
+private:
+	// Indexes left to a worker, claimed one at a time by it or by thieves
+	typedef struct alignas(64) work_share
+	{
+		std::atomic<int> next;
+		int end;
+	} work_share;
+
+	void worker_main(int worker);
+	void work(int worker);
+
+	int m_num_workers = 1;
+	std::vector<std::thread> m_threads;
+	work_share m_shares[WORK_POOL_MAX_WORKERS];
+	const std::function<void(int, int)> *m_task = nullptr;
+
+	// only one run at a time
+	std::mutex m_run_lock;
+
+	std::mutex m_lock;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	unsigned m_generation = 0;
+	int m_busy = 0;
+	bool m_quit = false;
+
+	static std::mutex s_shared_lock;
+	static work_pool *s_shared;
+};
+
+#endif